@@ -0,0 +1,432 @@
+/*
+** 冻结表、表映像、字符串池和字符串句柄的C API测试：
+**   cd src && make lua && gcc -o ../Lua/capi -I. ../Lua/capi.c \
+**     $(ls l*.o | grep -v -e '^lua.o' -e '^luac.o') -lm && ../Lua/capi
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+#define check(c)	((c) ? (void)0 : fail(#c, __LINE__))
+
+static void fail (const char *what, int line) {
+  fprintf(stderr, "capi.c:%d: check failed: %s\n", line, what);
+  exit(EXIT_FAILURE);
+}
+
+
+/* runs chunk 's' in 'L', leaving its result at the top */
+static void eval (lua_State *L, const char *s) {
+  if (luaL_dostring(L, s) != LUA_OK) {
+    fprintf(stderr, "%s\n", lua_tostring(L, -1));
+    exit(EXIT_FAILURE);
+  }
+}
+
+
+/* runs chunk 's' in 'L' with the value at the top as '...' */
+static void run (lua_State *L, const char *s) {
+  if (luaL_loadstring(L, s) != LUA_OK) {
+    fprintf(stderr, "%s\n", lua_tostring(L, -1));
+    exit(EXIT_FAILURE);
+  }
+  lua_insert(L, -2);
+  if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+    fprintf(stderr, "%s\n", lua_tostring(L, -1));
+    exit(EXIT_FAILURE);
+  }
+}
+
+
+/* 'release' for images in memory from 'malloc' */
+static void *freeimage (void *ud, void *p, size_t osize, size_t nsize) {
+  (void)ud; (void)osize; (void)nsize;
+  free(p);
+  return NULL;
+}
+
+
+/* loads into 'L' the image dumped in the string at the top of 'from' */
+static lua_Frozen *loadfrom (lua_State *L, lua_State *from) {
+  size_t size;
+  const char *s = lua_tolstring(from, -1, &size);
+  void *p = malloc(size);
+  check(p != NULL);
+  memcpy(p, s, size);
+  lua_pop(from, 1);
+  return lua_loadimage(L, p, size, freeimage, NULL);
+}
+
+
+/*
+** A state with the libraries open adopts a string pool and images made
+** by another state. The strings it already has with the contents of
+** strings of the images are replaced by them everywhere.
+*/
+static void attachopen (void) {
+  lua_State *A = luaL_newstate();
+  lua_State *B = luaL_newstate();
+  lua_Frozen *pool, *f;
+  luaL_openlibs(A);
+  pool = lua_poolstrings(A);
+  check(pool != NULL);
+  lua_pop(A, 1);
+  lua_pushfrozen(B, pool);  /* a new state takes the seed of the pool */
+  lua_pop(B, 1);
+  luaL_openlibs(B);
+  lua_pushnil(B);
+  run(B, "K = {}; K.alpha = 1; K['be' .. 'ta'] = 2\n"
+         "C = function () return 'alpha', 'gamma' end\n"
+         "local up = 'beta'; U = function () return up end\n"
+         "CO = coroutine.wrap(function (s) s = coroutine.yield(s) return s end)\n"
+         "assert(CO('gamma') == 'gamma')\n"
+         "debug.setuservalue(io.stdout, 'alpha')\n"
+         "setmetatable(K, {__index = function (_, k) return k .. '!' end})\n");
+  eval(A, "return {alpha = 'beta', gamma = {'alpha', 'delta'}}");
+  f = lua_freeze(A, -1);
+  check(f != NULL);
+  lua_pop(A, 1);
+  lua_pushfrozen(B, f);  /* B has 'alpha', 'beta' and 'gamma' already */
+  run(B, "local img = ...\n"
+         "assert(img.alpha == 'beta' and img.gamma[1] == 'alpha')\n"
+         "assert(K[img.gamma[1]] == 1 and K[img.alpha] == 2)\n"
+         "for k in pairs(img) do assert(k == 'alpha' or k == 'gamma') end\n"
+         "local a, g = C(); assert(img[a] == 'beta' and img[g][2] == 'delta')\n"
+         "assert(K[U()] == 2 and img[CO('gamma')] == img.gamma)\n"
+         "assert(img[debug.getuservalue(io.stdout)] == 'beta')\n"
+         "assert(K.delta == 'delta!' and K[img.gamma[2]] == 'delta!')\n"
+         "local t = {}; t['al' .. 'pha'] = 1; assert(t[img.gamma[1]] == 1)\n"
+         "collectgarbage(); assert(K.alpha == 1 and img.gamma[2] == 'delta')\n");
+  lua_releasefrozen(f);
+  lua_releasefrozen(pool);
+  lua_close(A);
+  lua_close(B);
+}
+
+
+/*
+** Images dumped by one state are loaded into another one: the first
+** one before the libraries (the state takes its seed), the second one
+** after them.
+*/
+static void images (void) {
+  lua_State *A = luaL_newstate();
+  lua_State *B = luaL_newstate();
+  lua_Frozen *f;
+  luaL_openlibs(A);
+  eval(A, "return table.dumpimage({print = 'print', n = {1, 2.5}})");
+  f = loadfrom(B, A);
+  lua_pop(B, 1);
+  luaL_openlibs(B);  /* 'print' is the string of the image */
+  lua_pushnil(B);
+  run(B, "X = {}; X.omega = 1; X['x' .. 'y'] = 2\n");
+  eval(A, "return table.dumpimage({omega = 'xy', s = {'omega'}})");
+  lua_releasefrozen(f);
+  f = loadfrom(B, A);
+  run(B, "local img = ...\n"
+         "assert(X[img.s[1]] == 1 and X[img.omega] == 2)\n"
+         "assert(img.omega == 'x' .. 'y' and _G[img.s[1]] == nil)\n"
+         "assert(not pcall(rawset, img, 'k', 1))\n"
+         "assert(not pcall(function () img.s[1] = 0 end))\n");
+  lua_releasefrozen(f);
+  lua_close(A);
+  lua_close(B);
+}
+
+
+/*
+** writes the first 'size' bytes of the string at the top of 'L' to a new
+** file 'name' (an image mapped from the old file must keep its pages)
+*/
+static void writefile (lua_State *L, const char *name, size_t size) {
+  FILE *f;
+  remove(name);
+  f = fopen(name, "wb");
+  check(f != NULL);
+  check(fwrite(lua_tostring(L, -1), 1, size, f) == size);
+  check(fclose(f) == 0);
+}
+
+
+/*
+** Images loaded from files with 'luaL_loadimage': into a new state,
+** then into the same state after the libraries, then pushed into a
+** state of their own. Bad files leave the state usable (but not new:
+** the error message is a string).
+*/
+static void imagefile (void) {
+  lua_State *A = luaL_newstate();
+  lua_State *B = luaL_newstate();
+  lua_State *C = luaL_newstate();
+  lua_Frozen *f, *g;
+  char name[L_tmpnam];
+  size_t size;
+  check(tmpnam(name) != NULL);
+  luaL_openlibs(A);
+  check(luaL_loadimage(A, name, NULL) == LUA_ERRFILE);  /* no file yet */
+  check(strstr(lua_tostring(A, -1), "cannot map") != NULL);
+  lua_pop(A, 1);
+  eval(A, "local t = {list = {}, name = 'root', pi = 3.5, yes = true}\n"
+          "for i = 1, 100 do t.list[i] = 'item' .. i end\n"
+          "return table.dumpimage(t)");
+  size = lua_rawlen(A, -1);
+  writefile(A, name, size);
+  check(luaL_loadimage(B, name, &f) == LUA_OK);
+  check(lua_getfield(B, -1, "name") == LUA_TSTRING);
+  check(strcmp(lua_tostring(B, -1), "root") == 0);
+  lua_pop(B, 1);
+  luaL_openlibs(B);
+  run(B, "local t = ...\n"
+         "assert(#t.list == 100 and t.list[100] == 'item100' and t.pi == 3.5)\n"
+         "assert(t.yes and t.name == 'ro' .. 'ot')\n"
+         "assert(not pcall(function () t.list[1] = 0 end))\n");
+  writefile(A, name, size / 2);  /* truncated */
+  check(luaL_loadimage(B, name, NULL) != LUA_OK);
+  check(strstr(lua_tostring(B, -1), name) != NULL);
+  lua_pop(B, 1);
+  lua_pop(A, 1);
+  eval(A, "return ('garbage'):rep(20)");
+  writefile(A, name, lua_rawlen(A, -1));
+  check(luaL_loadimage(B, name, NULL) != LUA_OK);
+  lua_pop(A, 1);
+  lua_pop(B, 1);
+  eval(A, "return table.dumpimage({second = {'item1'}})");
+  writefile(A, name, lua_rawlen(A, -1));
+  lua_pop(A, 1);
+  check(luaL_loadimage(B, name, NULL) != LUA_OK);  /* 'item1' in both */
+  check(strstr(lua_tostring(B, -1), "already in another one") != NULL);
+  lua_pop(B, 1);
+  eval(A, "return table.dumpimage({second = {'other'}})");
+  writefile(A, name, lua_rawlen(A, -1));
+  lua_pop(A, 1);
+  check(luaL_loadimage(B, name, &g) == LUA_OK);  /* same seed as the first */
+  run(B, "local s = ...\n"
+         "local t = {}; t['oth' .. 'er'] = true\n"
+         "assert(s.second[1] == 'other' and t[s.second[1]])\n");
+  lua_pushfrozen(C, f);  /* shared with a state of its own */
+  luaL_openlibs(C);
+  run(C, "local t = ...; assert(t.list[7] == 'item7')\n");
+  lua_close(B);
+  lua_close(C);  /* 'f' and 'g' outlive the states */
+  lua_releasefrozen(f);
+  lua_releasefrozen(g);
+  lua_close(A);
+  remove(name);
+}
+
+
+/* pushes the string 's' made in 'L' and returns its contents */
+static const char *intern (lua_State *L, const char *s) {
+  eval(L, s);
+  return lua_tostring(L, -1);
+}
+
+
+/*
+** A string pool made by a template state and attached by two workers:
+** short strings of the pool are the same object in every state, and
+** the pool outlives the template.
+*/
+static void pool (void) {
+  lua_State *T = luaL_newstate();
+  lua_State *W1 = luaL_newstate();
+  lua_State *W2 = luaL_newstate();
+  lua_State *P = luaL_newstate();
+  lua_Frozen *p;
+  int plain, pooled;
+  luaL_openlibs(T);
+  eval(T, "return {'fieldname', 'other'}");  /* the host's field names */
+  p = lua_poolstrings(T);
+  check(p != NULL);
+  run(T, "local names = ...\n"
+         "local seen = {}\n"
+         "for _, s in ipairs(names) do seen[s] = true end\n"
+         "assert(seen.fieldname and seen.print and seen.__index)\n");
+  lua_close(T);  /* the pool stays */
+  lua_pushfrozen(W1, p);
+  lua_pop(W1, 1);
+  luaL_openlibs(W1);
+  lua_pushfrozen(W2, p);
+  lua_pop(W2, 1);
+  luaL_openlibs(W2);
+  check(intern(W1, "return 'field' .. 'name'") ==
+        intern(W2, "return ('fieldname'):sub(1)"));
+  check(intern(W1, "return (next({__index = 1}))") ==
+        intern(W2, "return '__' .. 'index'"));
+  check(intern(W1, "return 'w1' .. 'only'") !=
+        intern(W2, "return 'w1only'"));  /* made after the pool */
+  check(intern(W1, "return ('long'):rep(20)") !=
+        intern(W2, "return ('long'):rep(20)"));  /* long strings are not */
+  lua_pushnil(W1);
+  run(W1, "local t = {}; t.fieldname = 1; t['w1' .. 'only'] = 2\n"
+          "collectgarbage()\n"
+          "assert(t['field' .. 'name'] == 1 and t.w1only == 2)\n");
+  luaL_openlibs(P);
+  plain = lua_gc(P, LUA_GCCOUNTB, 0) + 1024 * lua_gc(P, LUA_GCCOUNT, 0);
+  pooled = lua_gc(W2, LUA_GCCOUNTB, 0) + 1024 * lua_gc(W2, LUA_GCCOUNT, 0);
+  check(pooled < plain);  /* W2 has more on its stack, still less memory */
+  lua_close(W1);
+  lua_close(W2);
+  lua_close(P);
+  lua_releasefrozen(p);
+}
+
+
+/* freezing from C: tables reachable from the one frozen are frozen too */
+static void freeze (void) {
+  lua_State *L = luaL_newstate();
+  lua_Frozen *f;
+  luaL_openlibs(L);
+  eval(L, "return {a = {b = {}}, 'x'}");
+  f = lua_freeze(L, -1);
+  check(f != NULL);
+  lua_getfield(L, -1, "a");
+  check(lua_freeze(L, -1) == NULL);  /* already in an image */
+  lua_pop(L, 1);
+  run(L, "local t = ...\n"
+         "assert(not pcall(function () t.a.b.c = 1 end))\n"
+         "assert(not pcall(table.insert, t, 'y') and #t == 1)\n"
+         "assert(not pcall(setmetatable, t.a, {}))\n"
+         "assert(table.freeze(t) == t and t.a.b.c == nil)\n");
+  lua_releasefrozen(f);
+  lua_close(L);
+}
+
+
+/* string handles work as field names of tables and of images */
+static void handles (void) {
+  lua_State *L = luaL_newstate();
+  lua_Handle *hx, *hy;
+  luaL_openlibs(L);
+  hx = lua_newhandle(L, "x");
+  hy = lua_newhandle(L, "y");
+  check(lua_newhandle(L, "x") == hx && hx != hy);
+  check(strcmp(lua_pushhandle(L, hy), "y") == 0);
+  check(lua_gettop(L) == 1 && strcmp(lua_tostring(L, -1), "y") == 0);
+  lua_pop(L, 1);
+  lua_newtable(L);
+  lua_pushinteger(L, 10);
+  lua_setfield_h(L, -2, hx);
+  lua_pushinteger(L, 20);
+  lua_setfield(L, -2, "y");
+  check(lua_getfield_h(L, -1, hx) == LUA_TNUMBER && lua_tointeger(L, -1) == 10);
+  check(lua_getfield_h(L, -2, hy) == LUA_TNUMBER && lua_tointeger(L, -1) == 20);
+  lua_pop(L, 2);
+  check(lua_getfield(L, -1, "x") == LUA_TNUMBER && lua_tointeger(L, -1) == 10);
+  lua_pop(L, 1);
+  lua_pushvalue(L, -1);
+  run(L, "local t = ...\n"
+         "setmetatable(t, {__newindex = rawset, __index = function () return 0 end})\n"
+         "t.x = nil\n");
+  check(lua_getfield_h(L, -1, hx) == LUA_TNUMBER && lua_tointeger(L, -1) == 0);
+  lua_pop(L, 1);
+  lua_pushinteger(L, 30);
+  lua_setfield_h(L, -2, hx);  /* through '__newindex' */
+  check(lua_rawlen(L, -1) == 0 && lua_getfield(L, -1, "x") == LUA_TNUMBER &&
+        lua_tointeger(L, -1) == 30);
+  lua_pop(L, 2);
+  lua_gc(L, LUA_GCCOLLECT, 0);  /* handles are not collected */
+  lua_pushhandle(L, hx);
+  check(strcmp(lua_tostring(L, -1), "x") == 0);
+  lua_pop(L, 1);
+  lua_close(L);
+}
+
+
+/* t[h] = v, for a table 't', a handle 'h' and a value 'v' */
+static int sethandle (lua_State *L) {
+  lua_setfield_h(L, 1, (lua_Handle *)lua_touserdata(L, 2));
+  return 0;
+}
+
+
+/*
+** Handles on frozen tables, on strings (through their metatable) and on
+** a table that outgrows its shape; a handle to a string of a pool works
+** in every state using the pool.
+*/
+static void sharedhandles (void) {
+  lua_State *T = luaL_newstate();
+  lua_State *W1 = luaL_newstate();
+  lua_State *W2 = luaL_newstate();
+  lua_Frozen *p, *f;
+  lua_Handle *hk, *hlen, *hx;
+  const char *k;
+  int i;
+  luaL_openlibs(T);
+  eval(T, "return {'key'}");
+  p = lua_poolstrings(T);
+  lua_close(T);
+  lua_pushfrozen(W1, p);
+  lua_pop(W1, 1);
+  luaL_openlibs(W1);
+  lua_pushfrozen(W2, p);
+  lua_pop(W2, 1);
+  luaL_openlibs(W2);
+  hk = lua_newhandle(W1, "key");
+  check(lua_newhandle(W2, "key") == hk);  /* the string of the pool */
+  eval(W2, "return {key = 'w2'}");
+  check(lua_getfield_h(W2, -1, hk) == LUA_TSTRING);
+  check(strcmp(lua_tostring(W2, -1), "w2") == 0);
+  lua_pop(W2, 2);
+  eval(W1, "return {key = {key = 'deep'}}");
+  f = lua_freeze(W1, -1);
+  check(f != NULL);
+  check(lua_getfield_h(W1, -1, hk) == LUA_TTABLE);
+  check(lua_getfield_h(W1, -1, hk) == LUA_TSTRING);
+  check(strcmp(lua_tostring(W1, -1), "deep") == 0);
+  lua_pop(W1, 2);
+  lua_pushcfunction(W1, sethandle);
+  lua_pushvalue(W1, -2);
+  lua_pushlightuserdata(W1, hk);
+  lua_pushinteger(W1, 1);
+  check(lua_pcall(W1, 3, 0, 0) == LUA_ERRRUN);  /* the table is frozen */
+  lua_pop(W1, 2);
+  lua_pushfrozen(W2, f);  /* the same image in another state */
+  check(lua_getfield_h(W2, -1, hk) == LUA_TTABLE);
+  lua_pop(W2, 2);
+  hlen = lua_newhandle(W1, "len");
+  lua_pushliteral(W1, "abc");
+  check(lua_getfield_h(W1, -1, hlen) == LUA_TFUNCTION);  /* string.len */
+  lua_insert(W1, -2);
+  lua_call(W1, 1, 1);
+  check(lua_tointeger(W1, -1) == 3);
+  lua_pop(W1, 1);
+  hx = lua_newhandle(W1, "x");
+  lua_newtable(W1);
+  for (i = 0; i < 40; i++) {  /* past the keys of a shape */
+    lua_pushinteger(W1, i);
+    lua_setfield_h(W1, -2, hx);
+    k = lua_pushfstring(W1, "k%d", i);
+    lua_pushinteger(W1, i);
+    lua_setfield(W1, -3, k);
+    lua_pop(W1, 1);  /* key name */
+    check(lua_getfield_h(W1, -1, hx) == LUA_TNUMBER);
+    check(lua_tointeger(W1, -1) == i);
+    lua_pop(W1, 1);
+  }
+  lua_pop(W1, 1);
+  lua_close(W1);
+  lua_close(W2);
+  lua_releasefrozen(f);
+  lua_releasefrozen(p);
+}
+
+
+int main (void) {
+  attachopen();
+  images();
+  imagefile();
+  pool();
+  freeze();
+  handles();
+  sharedhandles();
+  printf("OK\n");
+  return 0;
+}
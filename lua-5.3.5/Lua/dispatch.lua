@@ -0,0 +1,79 @@
+-- 指令分发（跳转表）的回归测试：lua Lua/dispatch.lua
+
+-- a function using every opcode of the compiler but LOADKX
+local function every (n, ...)
+  local up = n                                  -- MOVE, GETUPVAL
+  local t = {1, 2, 3, x = "x", [n] = n}         -- NEWTABLE, SETLIST
+  local s = t.x .. "y" .. n                     -- GETTABLE, CONCAT
+  local f = function () up = up + 1; return up end  -- CLOSURE, SETUPVAL
+  local a, b = true, nil                        -- LOADBOOL, LOADNIL
+  local m = {get = function (self) return self.v end, v = 7}
+  local r = m:get()                             -- SELF
+  local k = n + 1 - 2 * 3 % 4 ^ 1 / 1 // 1      -- arithmetic
+  local bits = (n & 3 | 4 ~ 1) << 2 >> 1        -- bitwise
+  local u = -k + ~n + #t                        -- UNM, BNOT, LEN
+  if not a or b then error("bad") end           -- NOT, TEST, JMP
+  local c = a and n or 0                        -- TESTSET
+  if n == c and n < 10 and n <= 10 then u = u + 1 end  -- EQ, LT, LE
+  local sum = 0
+  for i = 1, 3 do sum = sum + i end             -- FORPREP, FORLOOP
+  for _, v in ipairs(t) do sum = sum + v end    -- TFORCALL, TFORLOOP
+  _G.dispatchglobal = s                          -- SETTABUP, GETTABUP
+  local v = select("#", ...)                    -- VARARG, CALL
+  return f() + r + k + bits + u + sum + v, s, dispatchglobal
+end
+
+local function expected (n)
+  local t = {1, 2, 3, x = "x", [n] = n}
+  local k = n + 1 - 2 * 3 % 4 ^ 1 / 1 // 1
+  return (n + 1) + 7 + k + ((n & 3 | 4 ~ 1) << 2 >> 1) +
+         (-k + ~n + #t + 1) + 12 + 2, "xy" .. n
+end
+
+for n = 1, 3 do
+  local r, s, g = every(n, "a", "b")
+  local er, es = expected(n)
+  assert(r == er and s == es and g == es)
+end
+
+-- deep tail calls
+local function tail (n) if n == 0 then return "done" end return tail(n - 1) end
+assert(tail(10000) == "done")
+
+-- count and line hooks see every instruction and every line
+local count = 0
+debug.sethook(function () count = count + 1 end, "", 1)
+every(3)
+debug.sethook()
+assert(count > 60)
+local lines = {}
+debug.sethook(function (_, l) lines[l] = true end, "l")
+every(3)
+debug.sethook()
+local nlines = 0
+for _ in pairs(lines) do nlines = nlines + 1 end
+assert(nlines >= 15)
+
+-- errors and yields from the middle of an instruction
+assert(not pcall(every, nil))
+local mt = {__add = function (a, b) return coroutine.yield(a.v + b) end,
+            __lt = function (a, b) return coroutine.yield(a.v < b.v) end,
+            __index = function (_, k) return coroutine.yield(k) end,
+            __concat = function (a, b) return coroutine.yield("c") end}
+local co = coroutine.wrap(function ()
+  local a = setmetatable({v = 1}, mt)
+  local b = setmetatable({v = 2}, mt)
+  local x = a + 10
+  local y = a < b
+  local z = a.field
+  local w = a .. "s"
+  return x, y, z, w
+end)
+assert(co() == 11)
+assert(co(11) == true)
+assert(co(true) == "field")
+assert(co("F") == "c")
+local x, y, z, w = co("C")
+assert(x == 11 and y == true and z == "F" and w == "C")
+
+print("OK")
@@ -0,0 +1,84 @@
+-- 超级指令（融合的指令对）的回归测试：lua Lua/fused.lua
+
+-- the four pairs: mod.func, a.b.c, f(), and a local function called
+ffused = function (...) return select("#", ...), ... end
+local function pairsfn (t)
+  local fmt = string.format                    -- GETTABUP+GETTABLE
+  local c = t.a.b.c                            -- GETTABLE+GETTABLE (twice)
+  local n = ffused()                           -- GETTABUP+CALL
+  local g = ffused
+  local m, x = g(c)                            -- MOVE+CALL
+  return fmt("%d %d %s", n, m, x)
+end
+for _ = 1, 3 do
+  assert(pairsfn({a = {b = {c = "z"}}}) == "0 1 z")
+end
+
+-- errors in either half name the right thing
+local function msg (f, ...)
+  local ok, m = pcall(f, ...)
+  assert(not ok)
+  return m
+end
+local function deep (t) return t.a.b.c end
+assert(deep({a = {b = {c = 1}}}) == 1)
+assert(msg(deep, {}):find("field 'a'"))
+assert(msg(deep, {a = {}}):find("field 'b'"))
+assert(msg(deep, {a = 1}):find("field 'a'"))
+local function callg () return nofunction() end
+assert(msg(callg):find("global 'nofunction'"))
+local function callm (h, v) local k = h; return k(v) end
+assert(callm(tostring, 1) == "1")
+assert(msg(callm, nil, 1):find("local 'k'"))
+local function modf () return nomodule.f end
+assert(msg(modf):find("global 'nomodule'"))
+
+-- a metamethod in the first half yields; the second half runs after it
+local log = {}
+local env = setmetatable({}, {__index = function (_, k)
+  log[#log + 1] = k
+  return coroutine.yield(k)
+end})
+local f = load("local v = mod.field; local w = fn(); return v, w", "=y", "t", env)
+local co = coroutine.wrap(f)
+assert(co() == "mod")
+assert(co({field = 10}) == "fn")
+local v, w = co(function () return 20 end)
+assert(v == 10 and w == 20 and log[1] == "mod" and log[2] == "fn")
+local ix = setmetatable({}, {__index = function (_, k)
+  return setmetatable({}, {__index = function (_, k2)
+    return coroutine.yield(k .. "." .. k2)
+  end})
+end})
+co = coroutine.wrap(function (t) return t.p.q end)
+assert(co(ix) == "p.q" and co("done") == "done")
+
+-- hooks stop at the second instruction of a pair as at any other
+local lines, count = {}, 0
+debug.sethook(function (e, l)
+  if e == "count" then count = count + 1 else lines[#lines + 1] = l end
+end, "l", 1)
+pairsfn({a = {b = {c = "z"}}})
+debug.sethook()
+assert(count >= 12 and #lines >= 6)
+
+-- dumps and listings show only standard opcodes
+local src = "local t = ...; local a = string.rep; return t.x.y, a('x', 2), print"
+local fn = load(src)
+local d = string.dump(fn)
+assert(select(2, fn({x = {y = 1}})) == "xx")
+assert(string.dump(fn) == d)
+assert(load(d)({x = {y = 3}}) == 3)
+local luac = arg and arg[-1] and arg[-1]:gsub("lua$", "luac")
+local tmp, out = os.tmpname(), os.tmpname()
+local fh = io.open(tmp, "w"); fh:write(src); fh:close()
+if luac and os.execute(luac .. " -l -p " .. tmp .. " > " .. out .. " 2>&1") then
+  fh = io.open(out)
+  local listing = fh:read("a")
+  fh:close()
+  assert(listing:find("GETTABUP") and listing:find("GETTABLE"))
+  assert(not listing:find("_GETTABLE") and not listing:find("_CALL"))
+end
+os.remove(tmp); os.remove(out)
+
+print("OK")
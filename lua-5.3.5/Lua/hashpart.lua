@@ -0,0 +1,98 @@
+-- 散列部分的回归测试，默认布局和LUA_SWISSTABLE布局都应通过：lua Lua/hashpart.lua
+
+local function count (t)
+  local n = 0
+  for k, v in pairs(t) do
+    assert(t[k] == v)
+    n = n + 1
+  end
+  return n
+end
+
+-- every kind of key, at every size crossing a group or a resize
+local ud = io.stdout
+local kinds = {
+  function (i) return i + 0.5 end,
+  function (i) return "s" .. i end,
+  function (i) return ("long"):rep(12) .. i end,
+  function (i) return -i end,
+  function (i) return 2^40 + i end,
+}
+for _, n in ipairs({1, 7, 15, 16, 17, 31, 32, 33, 100, 1000}) do
+  local t = {[true] = "t", [false] = "f", [ud] = "ud"}
+  for i = 1, n do
+    for j, key in ipairs(kinds) do t[key(i)] = j * i end
+  end
+  for i = 1, n do
+    for j, key in ipairs(kinds) do assert(t[key(i)] == j * i) end
+  end
+  assert(t[true] == "t" and t[false] == "f" and t[ud] == "ud")
+  assert(t[0.25] == nil and t["s0"] == nil and t[("long"):rep(12)] == nil)
+  assert(count(t) == n * #kinds + 3)
+end
+
+-- churn: keys set to nil stay until a rehash, lookups go past them
+local t = {}
+for round = 1, 20 do
+  for i = 1, 200 do t["k" .. (round * 200 + i)] = i end
+  for i = 1, 200 do t["k" .. ((round - 1) * 200 + i)] = nil end
+  for i = 1, 200 do assert(t["k" .. (round * 200 + i)] == i) end
+end
+assert(count(t) == 200)
+
+-- clearing during traversal, and 'next' from a dead key
+for k in pairs(t) do t[k] = nil end
+assert(next(t) == nil)
+local u = {}
+for i = 1, 50 do u[i * 1.5] = i end
+local k1 = next(u)
+u[k1] = nil
+collectgarbage()
+local seen = 0
+local k = k1
+repeat k = next(u, k); if k then seen = seen + 1 end until not k
+assert(seen == 49)
+
+-- weak keys and values cleared from the hash part
+local wk = setmetatable({}, {__mode = "k"})
+local wv = setmetatable({}, {__mode = "v"})
+local eph = setmetatable({}, {__mode = "k"})
+local keep = {}
+for i = 1, 100 do
+  local o = {}
+  if i % 2 == 0 then keep[#keep + 1] = o end
+  wk[o] = i; wv["v" .. i] = o; eph[o] = {o}
+end
+collectgarbage()
+assert(count(wk) == 50 and count(wv) == 50 and count(eph) == 50)
+for _, o in ipairs(keep) do assert(wk[o] and eph[o][1] == o) end
+
+-- long-string keys with the same length and prefix
+local long = {}
+local pre = ("x"):rep(100)
+for i = 1, 300 do long[pre .. string.format("%04d", i)] = i end
+for i = 1, 300 do assert(long[pre .. string.format("%04d", i)] == i) end
+assert(long[pre .. "0000"] == nil)
+
+-- users reaching values through the key's slot: hints, methods, the lexer
+local big = {}
+for i = 1, 40 do big["f" .. i] = i end           -- too many keys for a shape
+local function getf (o) return o.f20 end
+assert(getf(big) == 20)
+big.f20 = "new"
+assert(getf(big) == "new")
+big.f20 = nil
+for i = 41, 200 do big["f" .. i] = i end         -- rehash moves 'f20'
+big.f20 = 20
+assert(getf(big) == 20)
+local class = {__index = big}
+function big:m () return self.v end
+local obj = setmetatable({v = "v"}, class)
+for _ = 1, 3 do assert(obj:m() == "v") end
+local src = {"return {"}
+for i = 1, 300 do src[#src + 1] = string.format("s%d = 's%d',", i, i) end
+src[#src + 1] = "}"
+local lexed = load(table.concat(src))()
+for i = 1, 300 do assert(lexed["s" .. i] == "s" .. i) end
+
+print("OK")
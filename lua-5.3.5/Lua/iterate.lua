@@ -0,0 +1,81 @@
+-- 泛型for中内联执行next/ipairs的回归测试：lua Lua/iterate.lua
+
+local t = {10, 20, 30, x = "x", y = "y", [1.5] = "f"}
+
+-- the same results as calling the functions
+local function collect (f, s, c)
+  local out = {}
+  for k, v in f, s, c do out[#out + 1] = tostring(k) .. "=" .. tostring(v) end
+  return table.concat(out, " ")
+end
+local function wrap (f) return function (...) return f(...) end end
+assert(collect(pairs(t)) == collect(wrap(next), t, nil))
+assert(collect(ipairs(t)) == "1=10 2=20 3=30")
+local ipf = ipairs({})
+assert(collect(ipairs(t)) == collect(wrap(ipf), t, 0))
+assert(collect(next, t, "x") == collect(wrap(next), t, "x"))   -- user start
+assert(collect(next, {}) == "" and collect(ipairs({nil, 2})) == "")
+
+-- nested loops over one table, and next() between steps
+local pairsn = 0
+for k1 in pairs(t) do
+  for k2 in pairs(t) do
+    pairsn = pairsn + 1
+    assert(next(t, k2) == select(1, next(t, k2)))
+  end
+  assert(t[k1] ~= nil)
+end
+assert(pairsn == 36)
+
+-- ipairs respects '__index'; pairs respects '__pairs'
+local proxy = setmetatable({}, {__index = function (_, i)
+  if i <= 3 then return i * 2 end
+end})
+assert(collect(ipairs(proxy)) == "1=2 2=4 3=6")
+local pp = setmetatable({}, {__pairs = function (s)
+  return function (_, k) if not k then return 1, "one" end end, s, nil
+end})
+assert(collect(pairs(pp)) == "1=one")
+local withmt = setmetatable({1, 2}, {__index = {3, 4, 5}})
+assert(collect(ipairs(withmt)) == "1=1 2=2 3=5")
+
+-- errors from an invalid key, and clearing fields while iterating
+assert(not pcall(function () for _ in next, t, "nokey" do end end))
+local c = {a = 1, b = 2, c = 3, 1, 2}
+for k in pairs(c) do c[k] = nil end
+assert(next(c) == nil)
+
+-- hooks see a call and a return for each step
+local calls = 0
+debug.sethook(function (e)
+  local info = debug.getinfo(2, "f")
+  if info and (info.func == next or info.func == ipf) then calls = calls + 1 end
+end, "cr")
+for _ in pairs({1, 2, 3}) do end
+for _ in ipairs({1, 2, 3}) do end
+debug.sethook()
+assert(calls == 16)                                -- 4+4 steps, call+return
+
+-- the control variable is the key, also for debug.getlocal
+for k in pairs({z = 1}) do
+  local i = 1
+  while true do
+    local name, v = debug.getlocal(1, i)
+    if not name then break end
+    if name == "(for control)" then assert(v == k) end
+    i = i + 1
+  end
+end
+
+-- coroutines yielding in the loop body
+local co = coroutine.wrap(function (tab)
+  for k, v in pairs(tab) do coroutine.yield(k, v) end
+  for i, v in ipairs(tab) do coroutine.yield(i, v) end
+  return "end"
+end)
+local got = {}
+local k, v = co({5, 6})
+while k ~= "end" do got[#got + 1] = k .. v; k, v = co() end
+assert(table.concat(got, ",") == "15,26,15,26")
+
+print("OK")
@@ -0,0 +1,57 @@
+-- '#'的边界缓存的回归测试：lua Lua/length.lua
+
+local function border (t)
+  local n = #t
+  assert(n == 0 or t[n] ~= nil)
+  assert(t[n + 1] == nil)
+  return n
+end
+
+-- push and pop, through '#t+1', table.insert and table.remove
+local t = {}
+for i = 1, 1000 do t[#t + 1] = i; assert(border(t) == i) end
+for i = 1000, 1, -1 do assert(border(t) == i); t[#t] = nil end
+assert(border(t) == 0)
+for i = 1, 500 do table.insert(t, i) end
+table.insert(t, 1, 0)
+assert(border(t) == 501 and t[1] == 0 and t[501] == 500)
+for i = 501, 1, -1 do assert(table.remove(t) == i - 1) end
+assert(border(t) == 0)
+
+-- writes far from the remembered border
+t = {}
+for i = 1, 64 do t[i] = i end
+assert(border(t) == 64)
+t[10] = nil
+border(t)                                         -- either 9 or 64
+t[10] = 10; t[64] = nil; t[63] = nil
+assert(border(t) == 62)
+for i = 1, 62 do t[i] = nil end
+assert(border(t) == 0)
+t[1] = 1
+assert(border(t) == 1)
+
+-- constructors, resizes and random writes
+assert(#{1, 2, 3} == 3 and #{n = 1} == 0 and border({1, 2, nil, 4}))
+local c = {1, 2, 3, nil, nil}
+assert(border(c) == 3)
+local r = {}
+for i = 1, 300 do r[i] = i end
+for i = 1, 300 do r[i] = nil end
+collectgarbage()
+r.x = 1                                           -- may shrink the array part
+assert(border(r) == 0)
+math.randomseed(14)
+local m = {}
+for _ = 1, 20000 do
+  local i = math.random(1, 128)
+  if math.random() < 0.6 then m[i] = i else m[i] = nil end
+  border(m)
+end
+
+-- '__len' and the API paths still agree
+local p = setmetatable({1, 2, 3}, {__len = function () return 42 end})
+assert(#p == 42 and rawlen(p) == 3)
+assert(select("#", table.unpack({1, 2, 3, 4})) == 4)
+
+print("OK")
@@ -0,0 +1,54 @@
+-- luac -c（把预编译的chunk嵌入C源码）的回归测试：lua Lua/luacc.lua
+-- 需要luac与解释器在同一个目录中，找不到时跳过
+
+local luac = arg and arg[-1] and arg[-1]:match("^(.*lua)$")
+luac = luac and luac .. "c"
+local function sh (cmd) return os.execute(cmd .. " 2>/dev/null") end
+if not (luac and sh(luac .. " -v > /dev/null")) then
+  print("OK (no luac)")
+  return
+end
+
+local function readall (name)
+  local f = assert(io.open(name, "rb"))
+  local s = f:read("a")
+  f:close()
+  return s
+end
+
+local src, csrc, bin = os.tmpname(), os.tmpname(), os.tmpname()
+local f = io.open(src, "w")
+f:write("local name = ...\nreturn {name = name, sum = 1 + 2}\n")
+f:close()
+
+-- the C array holds exactly the bytes of the binary chunk
+for _, strip in ipairs({"", "-s "}) do
+  assert(sh(luac .. " " .. strip .. "-o " .. bin .. " " .. src))
+  assert(sh(luac .. " " .. strip .. "-c my.mod -o " .. csrc .. " " .. src))
+  local c = readall(csrc)
+  assert(c:find("LUAMOD_API int luaopen_my_mod%(lua_State%* L%)"))
+  assert(c:find('"=my.mod"', 1, true))
+  local bytes = {}
+  for n in c:match("chunk%[%]={(.-)};"):gmatch("%d+") do
+    bytes[#bytes + 1] = string.char(tonumber(n))
+  end
+  local chunk = table.concat(bytes)
+  assert(chunk == readall(bin))
+  local m = load(chunk, "=my.mod", "b")("my.mod")
+  assert(m.name == "my.mod" and m.sum == 3)
+end
+
+-- a second input file: still one chunk, line breaks every 16 bytes
+assert(sh(luac .. " -c two -o " .. csrc .. " " .. src .. " " .. src))
+for line in readall(csrc):gmatch("\n( [^\n]*,)") do
+  local n = select(2, line:gsub(",", ","))
+  assert(n <= 16)
+end
+
+-- bad module names are rejected
+assert(not sh(luac .. " -c '' " .. src))
+assert(not sh(luac .. " -c 'a-b' " .. src))
+assert(not sh(luac .. " -c"))
+
+os.remove(src); os.remove(csrc); os.remove(bin)
+print("OK")
@@ -0,0 +1,79 @@
+-- OP_SELF方法缓存的回归测试：lua Lua/mcache.lua
+
+local function class (parent)
+  local c = {}
+  c.__index = c
+  if parent then setmetatable(c, parent) end
+  return c
+end
+local function call (o) return o:m() end        -- one SELF site for all
+
+-- a three-level chain; the cached entry follows every change on it
+local A = class(); local B = class(A); local C = class(B)
+function A:m () return "A" end
+local o = setmetatable({}, C)
+for _ = 1, 3 do assert(call(o) == "A") end
+function A:m () return "A2" end                 -- overwrite at the holder
+assert(call(o) == "A2")
+function B:m () return "B" end                  -- shadow lower in the chain
+assert(call(o) == "B")
+rawset(C, "m", function () return "C" end)      -- shadow through rawset
+assert(call(o) == "C")
+C.m = nil; B.m = nil
+assert(call(o) == "A2")
+function o:m () return "own" end                -- the receiver has it
+assert(call(o) == "own")
+o.m = nil
+assert(call(o) == "A2")
+
+-- the chain itself changes
+local D = class()
+function D:m () return "D" end
+setmetatable(B, D)                               -- D replaces A
+assert(call(o) == "D")
+setmetatable(B, A)
+assert(call(o) == "A2")
+setmetatable(B, D)
+assert(call(o) == "D")
+setmetatable(o, D)
+assert(call(o) == "D")
+C.__index = D
+setmetatable(o, C)
+assert(call(o) == "D")
+C.__index = function (_, k) return function () return "fn " .. k end end
+assert(call(o) == "fn m")                        -- functions are not cached
+C.__index = C
+assert(pcall(call, setmetatable({}, class())) == false)
+
+-- more metatables at one site than the cache has entries
+local objs = {}
+for i = 1, 10 do
+  local k = class()
+  k.m = function () return i end
+  objs[i] = setmetatable({}, k)
+end
+for _ = 1, 3 do
+  for i, x in ipairs(objs) do assert(call(x) == i) end
+end
+
+-- strings go through the string metatable
+local function len (s) return s:len() end
+assert(len("abc") == 3)
+local orig = string.len
+string.len = function () return -1 end
+assert(len("abc") == -1)
+string.len = orig
+assert(len("abcd") == 4)
+
+-- a collected class table and a new one possibly at the same address
+local function fresh (v)
+  local k = class()
+  k.m = function () return v end
+  return setmetatable({}, k)
+end
+for i = 1, 50 do
+  assert(call(fresh(i)) == i)
+  if i % 10 == 0 then collectgarbage() end
+end
+
+print("OK")
@@ -0,0 +1,80 @@
+-- 按操作数类型特化的算术、比较指令的回归测试：lua Lua/quicken.lua
+
+local maxi, mini = math.maxinteger, math.mininteger
+
+local function add (a, b) return a + b end
+local function addk (a) return a + 1 end
+local function sub (a, b) return a - b end
+local function mul (a, b) return a * b end
+local function eq (a, b) return a == b end
+local function lt (a, b) return a < b end
+local function le (a, b) return a <= b end
+
+-- each site sees integers, then floats, then mixed, strings and tables
+local vec = setmetatable({}, {
+  __add = function (a, b) return "add" end, __sub = function () return "sub" end,
+  __mul = function () return "mul" end, __eq = function () return true end,
+  __lt = function () return true end, __le = function () return false end})
+local vec2 = setmetatable({}, getmetatable(vec))
+for _ = 1, 3 do
+  assert(add(1, 2) == 3 and math.type(add(1, 2)) == "integer")
+  assert(add(maxi, 1) == mini)                      -- integer wrap-around
+  assert(add(1.5, 2.25) == 3.75)
+  assert(add(1, 0.5) == 1.5 and add(0.5, 1) == 1.5)
+  assert(add("10", 1) == 11 and add(vec, 1) == "add")
+  assert(addk(41) == 42 and addk(0.5) == 1.5 and addk(maxi) == mini)
+  assert(addk("1") == 2 and addk(vec) == "add")
+  assert(sub(mini, 1) == maxi and sub(1.0, 0.5) == 0.5 and sub(vec, 1) == "sub")
+  assert(mul(maxi, 2) == -2 and mul(0.5, 4.0) == 2.0 and mul(3, 0.5) == 1.5)
+  assert(mul(vec, vec) == "mul")
+  assert(eq(1, 1) and not eq(1, 2) and eq(1, 1.0) and not eq(1, "1"))
+  assert(eq(vec, vec2) and not eq(vec, 1))
+  assert(lt(1, 2) and not lt(2, 1) and lt(1.5, 2.5) and lt(1, 1.5))
+  assert(not lt(0/0, 0/0) and not lt(0/0, 1.0) and lt(-1/0, 1/0))
+  assert(lt(mini, maxi) and lt("a", "b") and lt(vec, vec2))
+  assert(le(2, 2) and not le(3, 2) and le(1.5, 1.5) and not le(0/0, 0/0))
+  assert(le(maxi, maxi + 0.0) and le("a", "a") and not le(vec, vec2))
+  assert(lt(2^53, 2^53 + 1) == false and le(maxi, 2^63))   -- int/float order
+end
+
+-- a loop changing the type of its operands while running
+local s = 0
+for i = 1, 100 do
+  local x = (i % 3 == 0) and i + 0.5 or i
+  s = s + x
+  if x < 50 then s = s + 1 end
+end
+assert(s == 5050 + 33 * 0.5 + 49)
+
+-- error messages still name the variables
+local function name (f)
+  local ok, msg = pcall(f)
+  assert(not ok)
+  return msg
+end
+local function arith (a, b) local c = a + 1; return b + c end
+arith(1, 2); arith(1.5, 2.5)                       -- quickened
+assert(name(function () arith(nil, 1) end):find("local 'a'"))
+assert(name(function () arith(1, {}) end):find("local 'b'"))
+local gnil
+assert(name(function () return gnil * 2 end):find("upvalue 'gnil'"))
+assert(name(function () return lt(1, "x") end):find("compare number with string"))
+assert(name(function () return le({}, 1) end):find("compare table with number"))
+
+-- dumped code has only standard opcodes: the same before and after running
+local src = [[
+  local a, b = ...
+  local c = a + b + 1
+  if a < b and a <= b and a == b - (b - a) then c = c * 2 - 1 end
+  return c
+]]
+local f = load(src)
+local before = string.dump(f)
+local strip = string.dump(f, true)
+for i = 1, 10 do f(i, i + 1); f(i + 0.5, i + 1.5) end
+assert(string.dump(f) == before and string.dump(f, true) == strip)
+local g = load(before, "dumped", "b")
+assert(g(1, 2) == 7 and g(1.5, 2.5) == 9.0 and g(2, 1) == 4)
+assert(string.dump(g, true) == strip)
+
+print("OK")
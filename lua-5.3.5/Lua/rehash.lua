@@ -0,0 +1,59 @@
+-- 大散列部分的增量rehash的回归测试：lua Lua/rehash.lua
+
+local N = 16384                                   -- LUAI_MINHASHMOVE
+
+local function check (t, n, f)
+  local seen, cnt = {}, 0
+  for k, v in pairs(t) do
+    assert(not seen[k] and v == f(k))             -- each key exactly once
+    seen[k] = true
+    cnt = cnt + 1
+  end
+  assert(cnt == n)
+end
+local function val (k) return tonumber(k:sub(2)) end
+
+-- traversal, lookups and writes just after each doubling, while the
+-- old part is still being moved
+local t = {}
+local n = 0
+for _, size in ipairs({N + 1, 2 * N + 1}) do
+  while n < size do n = n + 1; t["k" .. n] = n end
+  check(t, n, val)
+  for i = 1, n, 97 do assert(t["k" .. i] == i) end
+  assert(t.k0 == nil and t["k" .. (n + 1)] == nil)
+  for k, v in pairs(t) do t[k] = v end             -- overwriting is allowed
+  check(t, n, val)
+  for i = 1, 100 do n = n + 1; t["k" .. n] = n end -- a few more moves
+  check(t, n, val)
+end
+
+-- deleting while traversing a table under a move
+local d = {}
+for i = 1, N + 10 do d[i + 0.5] = i end
+local left = 0
+for k, v in pairs(d) do
+  if v % 2 == 0 then d[k] = nil else left = left + 1 end
+end
+assert(left == (N + 10 + 1) // 2)
+for k, v in pairs(d) do assert(v % 2 == 1 and k == v + 0.5) end
+
+-- the collector sees both parts; a second rehash merges the first
+local w = setmetatable({}, {__mode = "v"})
+local keep = {}
+for i = 1, N + 1 do
+  local o = {}
+  if i % 3 == 0 then keep[i] = o end
+  w["o" .. i] = o
+end
+collectgarbage()
+local live = 0
+for k, o in pairs(w) do assert(keep[tonumber(k:sub(2))] == o); live = live + 1 end
+assert(live == (N + 1) // 3)
+local m = {}
+for i = 1, N + 1 do m[i * 2.0 + 0.5] = i end
+for i = 1, 4 * N do m[-i - 0.5] = i end          -- grows past the pending move
+for i = 1, N + 1 do assert(m[i * 2.0 + 0.5] == i) end
+for i = 1, 4 * N do assert(m[-i - 0.5] == i) end
+
+print("OK")
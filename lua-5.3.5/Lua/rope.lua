@@ -0,0 +1,64 @@
+-- 长字符串连接结果（rope）的回归测试：lua Lua/rope.lua
+
+local piece = string.rep("abcdefgh", 40)         -- longer than one rope piece
+
+-- accumulating, then every way of reading the result
+local s, parts = "", {}
+for i = 1, 500 do
+  s = s .. piece .. i
+  parts[i] = piece .. i
+end
+local flat = table.concat(parts)
+assert(#s == #flat)
+local lazy = {[flat .. "!"] = "k"}
+assert(lazy[s .. "!"] == "k")                    -- hashed from the pieces
+assert(s .. "?" ~= flat .. "!" and s .. "!" == flat .. "!")
+assert(s == flat and flat == s)                  -- rope against flat string
+assert(s:sub(-3) == "500" and s:byte(1) == 97 and s:find("h499abc", 1, true))
+local t = {[flat] = 1}
+assert(t[s] == 1)                                -- same hash and key equality
+assert(s < flat .. "x" and not (s < flat))
+
+-- two ropes sharing a prefix, each extended on its own
+local base = piece .. piece
+local r1 = base .. "one" .. piece
+local r2 = base .. "two" .. piece
+local r3 = r1 .. "more"
+assert(r1 ~= r2 and r1:sub(#base + 1, #base + 3) == "one")
+assert(r2:sub(#base + 1, #base + 3) == "two" and r3:sub(-4) == "more")
+assert(r1 == base .. "one" .. piece)
+
+-- numbers, loop limits and arithmetic on a rope
+local num = "1" .. string.rep("0", 300)
+assert(tonumber(num) == 1e300 and num + 0 == 1e300 and math.type(num * 1) == "float")
+local cnt = 0
+for _ = 1, ("0"):rep(300) .. "3" do cnt = cnt + 1 end
+assert(cnt == 3)
+
+-- formatting and C functions taking strings
+assert(("%s"):format(s) == flat and tostring(s) == flat)
+assert(string.format("%q", s):sub(2, 9) == "abcdefgh")
+assert(#string.upper(s) == #s and s:rep(2) == flat .. flat)
+
+-- weak tables with rope keys, and collection while ropes share pieces
+local weak = setmetatable({}, {__mode = "k"})
+weak[s] = true
+collectgarbage()
+assert(weak[flat] == true)                       -- strings are never weak
+local keep = {}
+for i = 1, 50 do
+  local x = piece
+  for j = 1, 20 do x = x .. j end
+  keep[i] = x
+  if i % 10 == 0 then collectgarbage() end
+end
+for i = 1, 50 do assert(keep[i] == keep[1]) end
+
+-- error messages built from ropes
+local ok, msg = pcall(error, s)
+assert(not ok and msg == flat)
+local big = setmetatable({}, {__name = ("N"):rep(300) .. "x"})
+ok, msg = pcall(function () return big + 1 end)
+assert(not ok and msg:find("arithmetic"))
+
+print("OK")
@@ -0,0 +1,75 @@
+-- 只有短字符串key的小表（shape）的回归测试：lua Lua/shape.lua
+
+local function count (t)
+  local n = 0
+  for k, v in pairs(t) do
+    assert(rawget(t, k) == v)
+    n = n + 1
+  end
+  return n
+end
+
+-- many tables sharing shapes, keys added in different orders
+local recs = {}
+for i = 1, 1000 do
+  local r = {}
+  if i % 2 == 0 then r.x = i; r.y = -i else r.y = -i; r.x = i end
+  r.name = "r" .. i
+  recs[i] = r
+end
+collectgarbage()
+for i, r in ipairs(recs) do
+  assert(r.x == i and r.y == -i and r.name == "r" .. i and count(r) == 3)
+end
+
+-- delete, reinsert, and delete while traversing
+local t = {a = 1, b = 2, c = 3}
+t.b = nil
+assert(t.b == nil and count(t) == 2)
+t.b = 20
+assert(t.b == 20 and count(t) == 3)
+for k in pairs(t) do t[k] = nil end
+assert(next(t) == nil)
+t.z = 1
+assert(t.z == 1 and count(t) == 1)
+
+-- the key that does not fit converts to a normal hash part
+local u = {}
+for i = 1, 16 do u["k" .. i] = i end
+assert(count(u) == 16)
+u.k17 = 17
+assert(count(u) == 17)
+for i = 1, 17 do assert(u["k" .. i] == i) end
+local v = {p = 1, q = 2}
+v[1.5] = "f"; v[true] = "b"; v[{}] = "t"
+assert(v.p == 1 and v.q == 2 and v[1.5] == "f" and v[true] == "b" and count(v) == 5)
+local w = {p = 1}
+w[string.rep("long", 20)] = 2                    -- a long string key
+assert(w.p == 1 and w[string.rep("long", 20)] == 2)
+
+-- integer keys go to the array part and keep the shape
+local a = {name = "a"}
+for i = 1, 10 do a[i] = i end
+assert(#a == 10 and a.name == "a" and count(a) == 11)
+
+-- constructors, globals in a fresh environment, and weak values
+local env = setmetatable({}, {__index = _G})
+load("x = 1; y = 2; z = x + y", "=env", "t", env)()
+assert(env.z == 3 and count(env) == 3)
+local weak = setmetatable({}, {__mode = "v"})
+weak.keep = recs; weak.gone = {}
+collectgarbage()
+assert(weak.keep == recs and weak.gone == nil)
+
+-- shapes no table uses any more are collected with no harm to new ones
+for i = 1, 200 do
+  local r = {}
+  r["s" .. i] = i; r["t" .. i] = i
+  assert(count(r) == 2)
+end
+collectgarbage(); collectgarbage()
+local s = {}
+s.s1 = 1; s.t1 = 1
+assert(s.s1 == 1 and count(s) == 2)
+
+print("OK")
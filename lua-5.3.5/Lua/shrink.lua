@@ -0,0 +1,85 @@
+-- 表收缩的回归测试：lua Lua/shrink.lua
+
+-- clearing fields while traversing must survive collections in the loop
+local t = {}
+for i = 1, 1000 do t["k" .. i] = i end
+local n = 0
+for k in pairs(t) do
+  t[k] = nil
+  n = n + 1
+  if n == 800 then collectgarbage(); collectgarbage() end
+end
+assert(n == 1000 and next(t) == nil)
+
+-- same with integer keys in the hash part and in the array part
+t = {}
+for i = 1, 1000 do t[i * 7] = i; t[i] = i end
+local total = 0
+for _ in pairs(t) do total = total + 1 end
+n = 0
+for k in pairs(t) do
+  t[k] = nil
+  n = n + 1
+  if n % 300 == 0 then collectgarbage(); collectgarbage() end
+end
+assert(n == total and next(t) == nil)
+
+-- assigning to existing fields (even nil ones) during a traversal
+-- must not shrink the table: it would reorder the unvisited keys
+t = {}
+for i = 1, 5000 do t["r" .. i] = i end
+for i = 1, 4900 do t["r" .. i] = nil end
+collectgarbage(); collectgarbage()  -- flags 't' as mostly empty
+n = 0
+for k in pairs(t) do
+  t[k] = nil; t[k] = nil
+  n = n + 1
+end
+assert(n == 100 and next(t) == nil)
+
+-- same for nil slots in the array part, emptied while the traversal runs
+t = {}
+for i = 1, 5000 do t[i] = i end
+n = 0
+for k in pairs(t) do
+  t[k] = nil; t[k] = nil
+  if k > 1 then t[k - 1] = nil end
+  n = n + 1
+  if n % 1000 == 0 then collectgarbage(); collectgarbage() end
+end
+assert(n == 5000 and next(t) == nil)
+
+-- a table found mostly empty is shrunk by the collector, with no new key
+local function kb ()
+  collectgarbage(); collectgarbage()
+  return collectgarbage("count")
+end
+t = {}
+for i = 1, 5000 do t["s" .. i] = i end
+local full = kb()
+for k in pairs(t) do t[k] = nil end
+assert(kb() < full - 100)
+t.z = 1
+for i = 1, 100 do t[i] = i end
+for i = 1, 100 do assert(t[i] == i) end
+assert(t.z == 1)
+
+-- same for the array part
+t = {}
+for i = 1, 5000 do t[i] = i end
+full = kb()
+for i = 1, 5000 do t[i] = nil end
+assert(kb() < full - 50 and next(t) == nil)
+
+-- a traversal left with 'break' keeps the table until its next new key
+t = {}
+for i = 1, 5000 do t[i + 0.5] = i end
+full = kb()
+for k in pairs(t) do break end
+for i = 1, 5000 do t[i + 0.5] = nil end
+local before = kb()
+assert(before > full - 100)
+t.z = 1
+assert(kb() < before - 100)
+
+print("OK")
@@ -0,0 +1,75 @@
+-- 常量短字符串key的槽位提示的回归测试：lua Lua/slothint.lua
+
+-- one access site, many tables with the key at different places
+local function getx (t) return t.x end
+local function setx (t, v) t.x = v end
+
+local tables = {}
+for i = 1, 200 do
+  local t = {}
+  for j = 1, i % 23 do t["k" .. j] = j end     -- 'x' lands elsewhere each time
+  t.x = i
+  for j = 1, i % 7 do t[j] = j end
+  tables[i] = t
+end
+for _ = 1, 3 do
+  for i, t in ipairs(tables) do
+    assert(getx(t) == i)
+    setx(t, -i)
+    assert(t.x == -i and getx(t) == -i)
+    setx(t, i)
+  end
+end
+
+-- the remembered slot changes under the hint: resize, delete, reinsert
+local t = {x = 1, y = 2}
+assert(getx(t) == 1)
+for i = 1, 1000 do t["f" .. i] = i end        -- rehash: 'x' moves
+assert(getx(t) == 1)
+t.x = nil
+assert(getx(t) == nil)
+for i = 1, 1000 do t["f" .. i] = nil end
+setx(t, 3)                                     -- a new key through the site
+assert(getx(t) == 3 and t.y == 2)
+t.x = nil; t.y = nil
+collectgarbage()                               -- may shrink the table
+assert(getx(t) == nil)
+setx(t, 4)
+assert(getx(t) == 4 and next(t, next(t)) == nil)
+
+-- a slot now holding another key with the same remembered index
+local a = {x = 1}
+local b = {}
+b.y = 10; b.x = 20
+assert(getx(a) == 1 and getx(b) == 20)
+b.x = nil; b.z = 30
+assert(getx(b) == nil and getx(a) == 1)
+
+-- sites that miss go to '__index' / '__newindex'
+local log = {}
+local p = setmetatable({}, {__index = function (_, k) return k .. "!" end,
+                            __newindex = function (_, k, v) log[k] = v end})
+assert(getx(p) == "x!")
+setx(p, 5)
+assert(log.x == 5 and rawget(p, "x") == nil)
+assert(getx(t) == 4)
+
+-- globals ('_ENV' is an upvalue) through a grown and shrunk global table
+gx = 1
+local function getgx () return gx end
+assert(getgx() == 1)
+for i = 1, 2000 do _G["g" .. i] = i end
+assert(getgx() == 1)
+for i = 1, 2000 do _G["g" .. i] = nil end
+gx = 2
+collectgarbage()
+assert(getgx() == 2)
+gx = nil
+assert(getgx() == nil)
+
+-- same key constant in several functions and several sites of one function
+local function both (t, u) return t.x, u.x, t.x end
+local r1, r2, r3 = both({x = "a"}, {y = 0, x = "b"})
+assert(r1 == "a" and r2 == "b" and r3 == "a")
+
+print("OK")
@@ -0,0 +1,50 @@
+-- 字符串散列（散列全部字节）的回归测试：lua Lua/strhash.lua
+
+-- keys differing in one byte anywhere, for every length around the
+-- 8-byte blocks and the short/long string limit
+for len = 1, 70 do
+  local t, n = {}, 0
+  local base = ("a"):rep(len)
+  for pos = 1, len do
+    for _, c in ipairs({"b", "\0", "\255"}) do
+      local k = base:sub(1, pos - 1) .. c .. base:sub(pos + 1)
+      assert(t[k] == nil)
+      t[k] = pos
+      n = n + 1
+    end
+  end
+  t[base] = 0
+  local cnt = 0
+  for k, v in pairs(t) do
+    assert(#k == len and (v == 0) == (k == base))
+    cnt = cnt + 1
+  end
+  assert(cnt == n + 1)
+end
+
+-- long keys sharing a prefix and a suffix
+local pre, suf = "https://example.com/items/", "/details?lang=en"
+local urls = {}
+for i = 1, 5000 do urls[pre .. i .. suf] = i end
+for i = 1, 5000 do assert(urls[pre .. i .. suf] == i) end
+assert(urls[pre .. "0" .. suf] == nil)
+
+-- the same bytes from any source hash alike: unaligned substrings,
+-- gsub results, ropes and numbers converted to strings
+local bytes = {}
+for i = 1, 100 do bytes[i] = string.char(i * 7 % 256) end
+local s = table.concat(bytes)
+local keys = {}
+for i = 1, 20 do keys[s:sub(i, i + 37)] = i end
+for i = 1, 20 do
+  local k = table.concat({s:sub(i, i + 17), s:sub(i + 18, i + 37)})
+  assert(keys[k] == i)
+end
+local long = ("z"):rep(400)
+local r = ("z"):rep(200) .. ("z"):rep(200)
+keys[long] = "flat"
+assert(keys[r] == "flat" and keys[("z"):rep(399) .. "z"] == "flat")
+keys[tostring(12345.5)] = "n"
+assert(keys["12345.5"] == "n" and keys[("1234 5"):gsub(" ", "") .. ".5"] == "n")
+
+print("OK")
@@ -0,0 +1,44 @@
+-- 字符串表的增量resize的回归测试：lua Lua/strtab.lua
+-- 短字符串按地址比较：移动中漏查了旧桶就会造出重复的字符串，下面的比较会失败
+
+local N = 1 << 16                                 -- LUAI_MINSTRTMOVE
+
+-- grow past the limit, and look up old strings just after each doubling
+local keep, byname = {}, {}
+for i = 1, 2 * N + 100 do
+  local s = "str" .. i
+  keep[i] = s
+  byname[s] = i
+  if i & (i - 1) == 0 or i % 10007 == 0 then      -- near a resize, and a few more
+    for j = 1, i, (i // 50) + 1 do
+      local again = "str" .. j
+      assert(again == keep[j] and byname[again] == j)
+    end
+  end
+end
+
+-- collector steps while strings still move; new strings meanwhile
+collectgarbage("restart")
+for i = 1, 2000 do
+  collectgarbage("step", 0)
+  local s = "new" .. i
+  byname[s] = -i
+  assert(byname["str" .. (i * 61 % (2 * N) + 1)] == i * 61 % (2 * N) + 1)
+end
+for i = 1, 2000 do assert(byname["new" .. i] == -i) end
+
+-- dropping most strings shrinks the table; survivors stay unique
+for i = 1, 2 * N + 100 do
+  if i % 100 ~= 0 then keep[i] = nil; byname["str" .. i] = nil end
+end
+collectgarbage(); collectgarbage()
+for i = 100, 2 * N + 100, 100 do
+  assert(byname["str" .. i] == i and keep[i] == "str" .. i)
+end
+local weak = setmetatable({}, {__mode = "v"})
+for i = 1, N + 1 do weak[i] = {} ; local _ = "tmp" .. i end
+collectgarbage()
+assert(next(weak) == nil)
+for i = 100, 2 * N + 100, 100 do assert(byname["st" .. "r" .. i] == i) end
+
+print("OK")
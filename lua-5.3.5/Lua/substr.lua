@@ -0,0 +1,24 @@
+-- 子串视图的回归测试：lua Lua/substr.lua
+
+local big = string.rep("abcdefghij", 100)
+
+-- views shorter than LUAI_MINROPE as operands of a copied concatenation
+for len = 128, 255 do
+  local v = big:sub(1, len)
+  local c = v .. "x"
+  assert(#c == len + 1 and c:sub(-1) == "x" and c:sub(1, len) == v)
+  c = "<" .. v .. ">"
+  assert(#c == len + 2 and c == "<" .. big:sub(1, len) .. ">")
+end
+
+-- two views, and a view from a pattern capture
+local a, b = big:sub(3, 132), big:sub(201, 330)
+assert(a .. b == big:sub(3, 132) .. big:sub(201, 330))
+local cap = big:match("^(" .. string.rep(".", 140) .. ")")
+assert(#(cap .. "!") == 141 and (cap .. "!"):sub(1, 140) == big:sub(1, 140))
+
+-- a view that reaches the rope path still works
+local r = big:sub(1, 200) .. big:sub(1, 200)
+assert(#r == 400 and r == string.rep(big:sub(1, 200), 2))
+
+print("OK")
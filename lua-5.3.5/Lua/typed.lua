@@ -0,0 +1,100 @@
+-- 类型化数组部分的回归测试（用-DLUA_TYPEDARRAY编译时才有类型化数组，
+-- 否则检查的是同样的语义）：lua Lua/typed.lua
+
+local N = 1024
+
+local function ints (n)
+  local t = {}
+  for i = 1, n do t[i] = i end
+  return t
+end
+
+local function check (t, n, f)
+  assert(#t == n)
+  for i = 1, n do assert(t[i] == f(i), i) end
+  assert(t[n + 1] == nil)
+end
+
+-- reading two elements before writing either (the element copy is shared)
+local t = ints(N)
+t[1], t[2] = t[2], t[1]
+assert(t[1] == 2 and t[2] == 1)
+for i = 1, N - 1 do t[i] = t[i] + t[i + 1] end
+for i = 1, N - 1 do assert(t[i] == 2 * i + 1 or i <= 2) end
+t = ints(N)
+local a, b, c = t[10], t[20], t[30]
+assert(a == 10 and b == 20 and c == 30)
+t[a], t[b] = t[b], t[a]
+assert(t[10] == 20 and t[20] == 10)
+t[10] = t[10] * t[20] - t[30]
+assert(t[10] == 170)
+
+-- sort, move and insert/remove work element by element
+t = ints(N)
+table.sort(t, function (x, y) return x > y end)
+check(t, N, function (i) return N + 1 - i end)
+table.move(t, 1, N - 1, 2)
+assert(t[1] == N and t[2] == N and t[N] == 2)
+t = ints(N)
+table.insert(t, 1, 0)
+check(t, N + 1, function (i) return i - 1 end)
+assert(table.remove(t, 1) == 0)
+check(t, N, function (i) return i end)
+assert(table.remove(t) == N)
+check(t, N - 1, function (i) return i end)
+t[N] = N
+check(t, N, function (i) return i end)
+
+-- traversals see every element with its own value
+t = ints(N)
+local n = 0
+for i, v in ipairs(t) do assert(v == i); n = n + 1 end
+assert(n == N)
+n = 0
+for k, v in pairs(t) do assert(k == v); n = n + 1 end
+assert(n == N)
+n = 0
+for k, v in next, t do assert(k == v); t[k] = v * 2; n = n + 1 end
+assert(n == N)
+check(t, N, function (i) return 2 * i end)
+
+-- boxing: a value of another type, a hole, an integer in a float array
+t = ints(N)
+t[N // 2] = "x"
+assert(t[N // 2] == "x" and t[N // 2 - 1] == N // 2 - 1 and #t == N)
+t = ints(N)
+t[N // 2] = nil
+assert(t[N // 2] == nil and t[N // 2 + 1] == N // 2 + 1)
+t[N // 2] = 0
+check(t, N, function (i) return i == N // 2 and 0 or i end)
+t = {}
+for i = 1, N do t[i] = i + 0.5 end
+t[3] = 3
+assert(math.type(t[3]) == "integer" and t[4] == 4.5)
+assert(math.type(t[N]) == "float")
+t = ints(N)
+t[1] = 1.0
+assert(math.type(t[1]) == "float" and math.type(t[2]) == "integer")
+t = ints(N)
+t[N + 1] = "y"       -- past the end of a full array: the hash part
+assert(t[N + 1] == "y" and t[N] == N)
+t[N + 1] = nil
+check(t, N, function (i) return i end)
+
+-- appending and removing at the end keep the values
+t = ints(N)
+for i = N + 1, 4 * N do t[i] = i end
+check(t, 4 * N, function (i) return i end)
+for i = 4 * N, 1, -1 do t[i] = nil end
+assert(#t == 0 and next(t) == nil)
+t[1] = 7
+assert(t[1] == 7 and #t == 1)
+
+-- C API access goes through the same paths
+t = ints(N)
+assert(select("#", table.unpack(t)) == N)
+assert(table.concat(t, ",", N - 2) == (N - 2) .. "," .. (N - 1) .. "," .. N)
+assert(rawget(t, 5) == 5 and rawequal(rawset(t, 5, 50), t) and t[5] == 50)
+assert(rawlen(t) == N)
+
+print("OK")
@@ -337,6 +337,7 @@ LUA_API int lua_isinteger (lua_State *L, int idx) {
 LUA_API int lua_isnumber (lua_State *L, int idx) {
   lua_Number n;
   const TValue *o = index2addr(L, idx);
+  luaS_flatvalue(L, o);
   return tonumber(o, &n);
 }
 
@@ -444,7 +445,9 @@ LUA_API size_t lua_stringtonumber (lua_State *L, const char *s) {
 LUA_API lua_Number lua_tonumberx (lua_State *L, int idx, int *pisnum) {
   lua_Number n;
   const TValue *o = index2addr(L, idx);
-  int isnum = tonumber(o, &n);
+  int isnum;
+  luaS_flatvalue(L, o);
+  isnum = tonumber(o, &n);
   if (!isnum)
     n = 0;  /* call to 'tonumber' may change 'n' even if it fails */
   if (pisnum) *pisnum = isnum;
@@ -456,7 +459,9 @@ LUA_API lua_Integer lua_tointegerx (lua_State *L, int idx, int *pisnum) {
   lua_Integer res;
   /* 取出idx在堆栈中对应的value值 */
   const TValue *o = index2addr(L, idx);
-  int isnum = tointeger(o, &res);
+  int isnum;
+  luaS_flatvalue(L, o);
+  isnum = tointeger(o, &res);
   if (!isnum)
     res = 0;  /* call to 'tointeger' may change 'n' even if it fails */
   if (pisnum) *pisnum = isnum;
@@ -492,6 +497,11 @@ LUA_API const char *lua_tolstring (lua_State *L, int idx, size_t *len) {
     o = index2addr(L, idx);  /* previous call may reallocate the stack */
     lua_unlock(L);
   }
+  else if (islazy(tsvalue(o))) {  /* rope without its contents yet? */
+    lua_lock(L);
+    luaS_flatten(L, tsvalue(o));
+    lua_unlock(L);
+  }
   
   /* 将字符串长度通过入参传递给调用者，并返回字符串的地址给调用者 */
   if (len != NULL)
@@ -628,6 +638,70 @@ LUA_API const char *lua_pushstring (lua_State *L, const char *s) {
 }
 
 
+/*
+** 压入索引'idx'处的字符串中从偏移'off'开始的'len'个字节。较长的子串是指向原串
+** 的视图（见'luaS_newsub'），不复制内容；在需要C字符串时才展开。
+*/
+LUA_API void lua_pushsubstring (lua_State *L, int idx, size_t off,
+                                                       size_t len) {
+  TString *ts;
+  StkId o;
+  lua_lock(L);
+  o = index2addr(L, idx);
+  api_check(L, ttisstring(o), "string expected");
+  api_check(L, off <= vslen(o) && len <= vslen(o) - off,
+                "substring out of bounds");
+  ts = luaS_newsub(L, tsvalue(o), off, len);
+  setsvalue2s(L, L->top, ts);
+  api_incr_top(L);
+  luaC_checkGC(L);
+  lua_unlock(L);
+}
+
+
+/*
+** 创建内容为's'的字符串句柄：这个字符串被钉在注册表中，在状态关闭之前不会被
+** 回收，所以句柄可以一直直接当作字符串对象使用。'lua_getfield_h'、
+** 'lua_setfield_h'和'lua_pushhandle'用它代替C字符串，省去每次调用时
+** 'luaS_new'的散列和查找。适合C代码中固定的一组字段名；同一个字符串的
+** 多个句柄相同。
+** 's'必须是短字符串（不超过LUAI_MAXSHORTLEN字节）：长字符串不做内部化，
+** 注册表中已有内容相同的键时新的字符串对象不会被钉住。之后挂上的表映像中
+** 有相同的字符串时，状态的字符串被它替换，句柄随之失效（见'luaS_adopt'），
+** 所以句柄应当在挂上所有映像之后创建。
+*/
+LUA_API lua_Handle *lua_newhandle (lua_State *L, const char *s) {
+  Table *reg;
+  TString *ts;
+  TValue *slot;
+  lua_lock(L);
+  api_check(L, strlen(s) <= LUAI_MAXSHORTLEN, "handle string too long");
+  reg = hvalue(&G(L)->l_registry);
+  ts = luaS_new(L, s);
+  setsvalue2s(L, L->top, ts);  /* anchor it */
+  api_incr_top(L);
+  luaH_checkwatch(L, reg);
+  slot = luaH_set(L, reg, L->top - 1);  /* registry[ts] = true */
+  setbvalue(slot, 1);
+  invalidateTMcache(reg);
+  luaC_barrierback(L, reg, L->top - 1);
+  L->top--;
+  luaC_checkGC(L);
+  lua_unlock(L);
+  return cast(lua_Handle *, ts);
+}
+
+
+LUA_API const char *lua_pushhandle (lua_State *L, lua_Handle *h) {
+  TString *ts = cast(TString *, h);
+  lua_lock(L);
+  setsvalue2s(L, L->top, ts);
+  api_incr_top(L);
+  lua_unlock(L);
+  return getstr(ts);
+}
+
+
 LUA_API const char *lua_pushvfstring (lua_State *L, const char *fmt,
                                       va_list argp) {
   const char *ret;
@@ -735,12 +809,8 @@ LUA_API int lua_pushthread (lua_State *L) {
 ** auxgetstr()函数用于从table t中取出键值为k的value对象，并将该对象压入堆栈，
 ** 并更新堆栈指针+1，然后返回该value对象的类型
 */
-static int auxgetstr (lua_State *L, const TValue *t, const char *k) {
+static int auxgetstr (lua_State *L, const TValue *t, TString *str) {
   const TValue *slot;
-  
-  /* 根据k来创建table的键值对象 */
-  TString *str = luaS_new(L, k);
-
   if (luaV_fastget(L, t, str, slot, luaH_getstr)) {
     //在table内取到数据
     setobj2s(L, L->top, slot);
@@ -765,7 +835,8 @@ static int auxgetstr (lua_State *L, const TValue *t, const char *k) {
 LUA_API int lua_getglobal (lua_State *L, const char *name) {
   Table *reg = hvalue(&G(L)->l_registry);
   lua_lock(L);
-  return auxgetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), name);
+  /* 根据name来创建table的键值对象 */
+  return auxgetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), luaS_new(L, name));
 }
 
 
@@ -788,7 +859,14 @@ Pushes onto the stack the value t[k], where t is the value at the given index. A
 */
 LUA_API int lua_getfield (lua_State *L, int idx, const char *k) {
   lua_lock(L);
-  return auxgetstr(L, index2addr(L, idx), k);
+  return auxgetstr(L, index2addr(L, idx), luaS_new(L, k));
+}
+
+
+/* 同'lua_getfield'，但键是字符串句柄'k'（见'lua_newhandle'），不用再查找 */
+LUA_API int lua_getfield_h (lua_State *L, int idx, lua_Handle *k) {
+  lua_lock(L);
+  return auxgetstr(L, index2addr(L, idx), cast(TString *, k));
 }
 
 //idx是table 在stack的slot idx，n是arrayindex编号（1开始算）
@@ -941,10 +1019,8 @@ LUA_API int lua_getuservalue (lua_State *L, int idx) {
 ** 位于堆栈顶部的value对象保存到t这个table中，对应的键值为k这个字符串。将位于
 ** 堆栈顶部的value对象存入table之后，会将该value对象弹出堆栈，也就是L->top会减1。
 */
-static void auxsetstr (lua_State *L, const TValue *t, const char *k) {
+static void auxsetstr (lua_State *L, const TValue *t, TString *str) {
   const TValue *slot;
-  /* 创建一个值为k的字符串对象 */
-  TString *str = luaS_new(L, k);
   api_checknelems(L, 1);
   if (luaV_fastset(L, t, str, slot, luaH_getstr, L->top - 1))
     L->top--;  /* pop value */
@@ -966,7 +1042,8 @@ LUA_API void lua_setglobal (lua_State *L, const char *name) {
   Table *reg = hvalue(&G(L)->l_registry);
   lua_lock(L);  /* unlock done in 'auxsetstr' */
 
-  auxsetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), name);
+  /* 创建一个值为name的字符串对象 */
+  auxsetstr(L, luaH_getint(reg, LUA_RIDX_GLOBALS), luaS_new(L, name));
 }
 
 /*
@@ -990,7 +1067,14 @@ LUA_API void lua_settable (lua_State *L, int idx) {
 */
 LUA_API void lua_setfield (lua_State *L, int idx, const char *k) {
   lua_lock(L);  /* unlock done in 'auxsetstr' */
-  auxsetstr(L, index2addr(L, idx), k);
+  auxsetstr(L, index2addr(L, idx), luaS_new(L, k));
+}
+
+
+/* 同'lua_setfield'，但键是字符串句柄'k'（见'lua_newhandle'） */
+LUA_API void lua_setfield_h (lua_State *L, int idx, lua_Handle *k) {
+  lua_lock(L);  /* unlock done in 'auxsetstr' */
+  auxsetstr(L, index2addr(L, idx), cast(TString *, k));
 }
 
 
@@ -1019,6 +1103,7 @@ LUA_API void lua_rawset (lua_State *L, int idx) {
   api_checknelems(L, 2);
   o = index2addr(L, idx);
   api_check(L, ttistable(o), "table expected");
+  luaH_checkwatch(L, hvalue(o));
   slot = luaH_set(L, hvalue(o), L->top - 2);
   setobj2t(L, slot, L->top - 1);
   invalidateTMcache(hvalue(o));
@@ -1092,6 +1177,7 @@ LUA_API int lua_setmetatable (lua_State *L, int objindex) {
   */
   switch (ttnov(obj)) {
     case LUA_TTABLE: {
+      luaH_checkwatch(L, hvalue(obj));
       hvalue(obj)->metatable = mt;
       if (mt) {
         luaC_objbarrier(L, gcvalue(obj), mt);
@@ -1327,6 +1413,49 @@ LUA_API int lua_dump (lua_State *L, lua_Writer writer, void *data, int strip) {
 }
 
 
+/*
+** 冻结栈顶的表（同'lua_freeze'），把它和它能到达的所有对象写成一个表映像
+** （见'luaU_dumpimage'），交给'writer'。
+*/
+LUA_API int lua_dumpimage (lua_State *L, lua_Writer writer, void *data) {
+  Table *t;
+  lua_Frozen *f;
+  int status;
+  lua_lock(L);
+  api_checknelems(L, 1);
+  api_check(L, ttistable(L->top - 1), "table expected");
+  t = hvalue(L->top - 1);
+  f = luaH_freeze(L, t);
+  if (f != NULL)  /* only the state keeps a reference */
+    luaH_release(f);
+  status = luaU_dumpimage(L, t, writer, data);
+  lua_unlock(L);
+  return status;
+}
+
+
+/*
+** 压入'p'处的表映像的根表，返回映像（见'luaU_loadimage'）。映像的短字符串
+** 会成为状态的字符串，状态已有的相同字符串被替换（见'luaS_adopt'），所以
+** 映像要用状态的散列种子：刚创建的状态会采用映像的种子（见'luaL_loadimage'）
+*/
+LUA_API lua_Frozen *lua_loadimage (lua_State *L, void *p, size_t size,
+                                   lua_Alloc release, void *ud) {
+  lua_Frozen *f;
+  lua_lock(L);
+  f = luaU_loadimage(L, p, size, release, ud);
+  sethvalue(L, L->top, f->root);
+  api_incr_top(L);
+  lua_unlock(L);
+  return f;
+}
+
+
+LUA_API void *lua_imagebase (const void *p, size_t size) {
+  return luaU_imagebase(p, size);
+}
+
+
 /* 返回线程的状态 */
 LUA_API int lua_status (lua_State *L) {
   return L->status;
@@ -1437,6 +1566,20 @@ LUA_API int lua_next (lua_State *L, int idx) {
 }
 
 
+/*
+** Register the functions that behave as 'next' and as the iterator of
+** 'ipairs' (without metamethods): generic 'for' loops over a table that
+** use them run them inline. NULL unregisters.
+*/
+LUA_API void lua_setiterators (lua_State *L, lua_CFunction next,
+                               lua_CFunction inext) {
+  lua_lock(L);
+  G(L)->nextf = next;
+  G(L)->inextf = inext;
+  lua_unlock(L);
+}
+
+
 LUA_API void lua_concat (lua_State *L, int n) {
   lua_lock(L);
   api_checknelems(L, n);
@@ -1480,6 +1623,54 @@ LUA_API void lua_setallocf (lua_State *L, lua_Alloc f, void *ud) {
   lua_unlock(L);
 }
 
+
+/*
+** 冻结索引'idx'处的表及它能到达的所有表（见'luaH_freeze'）。返回的映像可以
+** 交给其他状态的'lua_pushfrozen'，用完后调用'lua_releasefrozen'；表已经是
+** 另一个映像的一部分时返回NULL。
+*/
+LUA_API lua_Frozen *lua_freeze (lua_State *L, int idx) {
+  StkId t;
+  lua_Frozen *f;
+  lua_lock(L);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  f = luaH_freeze(L, hvalue(t));
+  lua_unlock(L);
+  return f;
+}
+
+
+/* 压入映像'f'的根表；第一次使用'f'的状态会持有它的一个引用 */
+LUA_API void lua_pushfrozen (lua_State *L, lua_Frozen *f) {
+  lua_lock(L);
+  luaH_attach(L, f);
+  sethvalue(L, L->top, f->root);
+  api_incr_top(L);
+  lua_unlock(L);
+}
+
+
+LUA_API void lua_releasefrozen (lua_Frozen *f) {
+  luaH_release(f);
+}
+
+
+/*
+** 把状态当前所有的短字符串冻结成一个映像（字符串池），压入它的根表（以这些
+** 字符串为元素的序列）并返回映像。新状态最好在打开标准库之前用'lua_pushfrozen'
+** 挂上字符串池（这样它采用池的散列种子，也不用替换已有的字符串），之后池中的字符串（关键字、库函数名、字段名等）不再在每个
+** 状态中各自创建一份，多个状态中相同的短字符串就是同一个对象。
+*/
+LUA_API lua_Frozen *lua_poolstrings (lua_State *L) {
+  lua_Frozen *f;
+  lua_lock(L);
+  luaS_pushstrings(L);
+  f = luaH_freeze(L, hvalue(L->top - 1));
+  lua_unlock(L);
+  return f;
+}
+
 /* lua_newuserdata()用于创建一个userdata对象，同时将该对象压入堆栈并返回其内部缓冲区的首地址 */
 LUA_API void *lua_newuserdata (lua_State *L, size_t size) {
   Udata *u;
@@ -969,6 +969,157 @@ LUALIB_API int luaL_loadstring (lua_State *L, const char *s) {
 /* }====================================================== */
 
 
+
+/*
+** {======================================================
+** Table images
+** =======================================================
+*/
+
+typedef struct LoadI {
+  void *p;  /* the image */
+  size_t size;
+  lua_Alloc release;  /* how to free it */
+  void *ud;
+  int readonly;  /* true if it can be made read only after loading */
+  lua_Frozen *f;
+} LoadI;
+
+
+#if defined(LUA_USE_POSIX)	/* { */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void *unmapimage (void *ud, void *ptr, size_t osize, size_t nsize) {
+  (void)ud; (void)nsize;
+  munmap(ptr, osize);
+  return NULL;
+}
+
+
+/*
+** Maps the image in file 'filename'. At the address it was laid out
+** for, the mapping is shared and read only, so that all processes using
+** the image share its pages through the page cache; anywhere else it is
+** private, as the image must be relocated first.
+*/
+static int mapimage (lua_State *L, LoadI *li, const char *filename) {
+  struct stat st;
+  void *p, *base;
+  int fd = open(filename, O_RDONLY);
+  (void)L;
+  if (fd < 0) return 0;
+  if (fstat(fd, &st) != 0) { close(fd); return 0; }
+  li->size = (size_t)st.st_size;
+  li->release = unmapimage;
+  li->ud = NULL;
+  li->readonly = 0;
+  p = mmap(NULL, li->size, PROT_READ, MAP_SHARED, fd, 0);
+  if (p != MAP_FAILED && (base = lua_imagebase(p, li->size)) != p) {
+    munmap(p, li->size);
+    p = (base == NULL) ? MAP_FAILED :  /* not an image? */
+        mmap(base, li->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != base) {  /* not at its address? */
+      if (p != MAP_FAILED) munmap(p, li->size);
+      p = mmap(NULL, li->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      li->readonly = 1;
+    }
+  }
+  close(fd);  /* the mapping stays */
+  li->p = p;
+  return (p != MAP_FAILED);
+}
+
+
+/* lookups never write into an image: any write is a bug */
+#define protectimage(li)	mprotect((li)->p, (li)->size, PROT_READ)
+
+#else				/* }{ */
+
+/* ISO C has no mappings: read the image into a block of the state */
+static int mapimage (lua_State *L, LoadI *li, const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  long size;
+  if (f == NULL) return 0;
+  if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    return 0;
+  }
+  li->size = (size_t)size;
+  li->release = lua_getallocf(L, &li->ud);
+  li->readonly = 0;
+  li->p = (*li->release)(li->ud, NULL, 0, li->size);
+  if (li->size > 0 &&
+      (li->p == NULL || fread(li->p, 1, li->size, f) != li->size)) {
+    (*li->release)(li->ud, li->p, li->size, 0);
+    fclose(f);
+    return 0;
+  }
+  fclose(f);
+  return 1;
+}
+
+#define protectimage(li)	((void)0)
+
+#endif				/* } */
+
+
+static int doloadimage (lua_State *L) {
+  LoadI *li = (LoadI *)lua_touserdata(L, 1);
+  li->f = lua_loadimage(L, li->p, li->size, li->release, li->ud);
+  return 1;
+}
+
+
+/*
+** Loads the table image in file 'filename' (see 'lua_loadimage') and
+** pushes its root table. If 'pf' is not NULL, it gets the image with a
+** reference for the caller.
+** Short strings still compare by address, so the strings of the image
+** become the strings of the state with their contents, replacing the
+** equal strings that the state already has (see 'luaS_adopt'). Their
+** hashes use the seed of the state that made the image, so in practice
+** an image is loaded from C into a new state, right after 'luaL_newstate'
+** and before 'luaL_openlibs' or anything else that creates strings: such
+** a state takes the seed of the image, and other images made with that
+** seed can be loaded into it later. Once loaded, the image can be
+** pushed into other states with 'lua_pushfrozen' (the same rules apply
+** to them). There is no Lua function to load an image.
+** With LUA_USE_POSIX the file stays mapped while the image is in use:
+** as with shared libraries, replace it with a new file instead of
+** rewriting it in place.
+*/
+LUALIB_API int luaL_loadimage (lua_State *L, const char *filename,
+                               lua_Frozen **pf) {
+  LoadI li;
+  int status;
+  if (!mapimage(L, &li, filename)) {  /* (no new strings before loading) */
+    lua_pushfstring(L, "cannot map %s: %s", filename, strerror(errno));
+    return LUA_ERRFILE;
+  }
+  lua_pushcfunction(L, doloadimage);
+  lua_pushlightuserdata(L, &li);
+  status = lua_pcall(L, 1, 1, 0);
+  if (status != LUA_OK) {  /* the image was not loaded? */
+    (*li.release)(li.ud, li.p, li.size, 0);
+    lua_pushfstring(L, "%s: %s", filename, lua_tostring(L, -1));
+    lua_replace(L, -2);
+  }
+  else {
+    if (li.readonly) protectimage(&li);
+    if (pf != NULL) *pf = li.f;
+    else lua_releasefrozen(li.f);  /* the state keeps it */
+  }
+  return status;
+}
+
+/* }====================================================== */
+
+
 LUALIB_API int luaL_getmetafield (lua_State *L, int obj, const char *event) {
   if (!lua_getmetatable(L, obj))  /* no metatable? */
     return LUA_TNIL;
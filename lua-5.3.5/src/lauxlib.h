@@ -93,6 +93,8 @@ LUALIB_API int (luaL_loadfilex) (lua_State *L, const char *filename,
 LUALIB_API int (luaL_loadbufferx) (lua_State *L, const char *buff, size_t sz,
                                    const char *name, const char *mode);
 LUALIB_API int (luaL_loadstring) (lua_State *L, const char *s);
+LUALIB_API int (luaL_loadimage) (lua_State *L, const char *filename,
+                                lua_Frozen **pf);
 
 LUALIB_API lua_State *(luaL_newstate) (void);
 
@@ -528,6 +528,8 @@ LUAMOD_API int luaopen_base (lua_State *L) {
   /* set global _VERSION */
   lua_pushliteral(L, LUA_VERSION);
   lua_setfield(L, -2, "_VERSION");
+  /* 让虚拟机在泛型for循环中直接执行这两个迭代函数 */
+  lua_setiterators(L, luaB_next, ipairsaux);
 
   /* 
   ** 程序执行到之类，栈顶部的内容是_G表。_G表最初始的创建是在main()函数中调用luaL_newstate()
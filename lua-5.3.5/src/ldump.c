@@ -11,11 +11,19 @@
 
 
 #include <stddef.h>
+#include <string.h>
 
 #include "lua.h"
 
+#include "ldebug.h"
+#include "ldo.h"
+#include "lgc.h"
+#include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
+#include "lstring.h"
+#include "ltable.h"
 #include "lundump.h"
 
 
@@ -88,8 +96,13 @@ static void DumpString (const TString *s, DumpState *D) {
 
 
 static void DumpCode (const Proto *f, DumpState *D) {
+  int i;
   DumpInt(f->sizecode, D);
-  DumpVector(f->code, f->sizecode, D);
+  for (i = 0; i < f->sizecode; i++) {  /* save only generic opcodes */
+    Instruction inst = f->code[i];
+    SET_OPCODE(inst, GET_BASEOP(inst));
+    DumpVar(inst, D);
+  }
 }
 
 
@@ -213,3 +226,343 @@ int luaU_dump(lua_State *L, const Proto *f, lua_Writer w, void *data,
   return D.status;
 }
 
+
+/*
+** {======================================================
+** Table images
+** =======================================================
+*/
+
+/* objects in an image start at multiples of this */
+#define IMAGEALIGN	sizeof(L_Umaxalign)
+#define imagealign(n)	(((n) + IMAGEALIGN - 1) & ~(IMAGEALIGN - 1))
+
+/* make collectable value 'v' point to address 'p', keeping its tag */
+#define setgcptr(v,p)	(val_(v).gc = cast(GCObject *, (p)))
+
+
+typedef struct ImageState {
+  lua_State *L;
+  Table *root;  /* root of the table tree */
+  Table *offs;  /* offset in the image of each object (by address) */
+  GCObject **objs;  /* objects of the image, in order */
+  int nobjs;
+  int sizeobjs;
+  size_t *relocs;  /* offsets of the pointers inside the image */
+  int nrelocs;
+  int sizerelocs;
+  char *buff;  /* the image */
+  size_t size;  /* size of the image */
+  size_t base;  /* address it is laid out for */
+  size_t empty;  /* offset of the hash part of tables without one */
+  size_t strs;  /* offset of the set of short strings */
+  int sizestrs;
+} ImageState;
+
+
+#define imageaddr(S,off)	cast(void *, (S)->base + (off))
+
+
+static size_t objsize (GCObject *o) {
+  switch (o->tt) {
+    case LUA_TSHRSTR: return sizelstring(gco2ts(o)->shrlen);
+    case LUA_TLNGSTR: return sizelstring(gco2ts(o)->u.lnglen);
+    default: {
+      Table *t = gco2t(o);
+      size_t sz = imagealign(sizeof(Table)) + t->sizearray * sizeof(TValue);
+      lua_assert(o->tt == LUA_TTABLE && isfrozen(t));
+      if (!isdummy(t))
+        sz += nodevecsize(cast(size_t, sizenode(t))) * sizeof(Node);
+      return sz;
+    }
+  }
+}
+
+
+/* offset of object 'o', giving it one at the end of the image if needed */
+static size_t addobject (ImageState *S, GCObject *o) {
+  TValue k;
+  const TValue *v;
+  setpvalue(&k, o);
+  v = luaH_get(S->offs, &k);
+  if (!ttisnil(v))  /* already in the image? */
+    return cast(size_t, ivalue(v));
+  else {
+    size_t off = S->size;
+    setivalue(luaH_set(S->L, S->offs, &k), cast(lua_Integer, off));
+    luaM_growvector(S->L, S->objs, S->nobjs, S->sizeobjs, GCObject *,
+                    MAX_INT, "objects");
+    S->objs[S->nobjs++] = o;
+    S->size += imagealign(objsize(o));
+    return off;
+  }
+}
+
+
+static void checkvalue (ImageState *S, const TValue *o, int iskey) {
+  switch (ttype(o)) {
+    case LUA_TNIL: case LUA_TBOOLEAN: case LUA_TNUMINT: case LUA_TNUMFLT:
+      break;
+    case LUA_TLNGSTR:  /* the image cannot be written when it is used */
+      luaS_flat(S->L, tsvalue(o));
+      luaS_hashlongstr(tsvalue(o));
+      /* FALLTHROUGH */
+    case LUA_TSHRSTR:
+      addobject(S, gcvalue(o));
+      break;
+    case LUA_TTABLE:
+      if (iskey)  /* its place in the hash part depends on its address */
+        luaG_runerror(S->L, "cannot dump a table used as a key");
+      addobject(S, gcvalue(o));
+      break;
+    default:
+      luaG_runerror(S->L, "cannot dump a %s value", ttypename(ttnov(o)));
+  }
+}
+
+
+/*
+** Gives an offset to each object reachable from 'root' (which comes
+** first), after the header and the empty hash part; then to the set of
+** short strings, which ends the image.
+*/
+static void layout (ImageState *S, Table *root) {
+  int i, nstrs = 0;
+  S->size = imagealign(sizeof(ImageHeader));
+  S->empty = S->size;
+  S->size += imagealign(nodevecsize(1) * sizeof(Node));
+  addobject(S, obj2gco(root));
+  for (i = 0; i < S->nobjs; i++) {  /* 'objs' grows while it is traversed */
+    GCObject *o = S->objs[i];
+    if (o->tt == LUA_TSHRSTR)
+      nstrs++;
+    else if (o->tt == LUA_TTABLE) {
+      Table *t = gco2t(o);
+      unsigned int j;
+      if (t->metatable != NULL)
+        addobject(S, obj2gco(t->metatable));
+      for (j = 0; j < t->sizearray; j++)
+        checkvalue(S, &t->array[j], 0);
+      if (!isdummy(t)) {
+        Node *n, *limit = gnode(t, cast(size_t, sizenode(t)));
+        for (n = gnode(t, 0); n < limit; n++) {
+          if (!ttisnil(nval(t, n))) {
+            checkvalue(S, gkey(n), 1);
+            checkvalue(S, nval(t, n), 0);
+          }
+        }
+      }
+    }
+  }
+  S->sizestrs = 0;
+  if (nstrs > 0) {  /* same load factor as in 'luaH_freeze' */
+    S->sizestrs = 1;
+    while (S->sizestrs < 2 * nstrs)
+      S->sizestrs <<= 1;
+  }
+  S->strs = S->size;
+  S->size += imagealign(S->sizestrs * sizeof(TString *));
+}
+
+
+static size_t getoffset (ImageState *S, GCObject *o) {
+  TValue k;
+  setpvalue(&k, o);
+  return cast(size_t, ivalue(luaH_get(S->offs, &k)));
+}
+
+
+static void addreloc (ImageState *S, size_t at) {
+  luaM_growvector(S->L, S->relocs, S->nrelocs, S->sizerelocs, size_t,
+                  MAX_INT, "pointers");
+  S->relocs[S->nrelocs++] = at;
+}
+
+
+/* writes at offset 'at' value 'v', with its object (if any) in the image */
+static void putvalue (ImageState *S, size_t at, const TValue *v) {
+  TValue w = *v;
+  if (iscollectable(v)) {
+    setgcptr(&w, S->base + getoffset(S, gcvalue(v)));
+    addreloc(S, at);
+  }
+  memcpy(S->buff + at, &w, sizeof(TValue));
+}
+
+
+/*
+** Hash part used by tables that have none: with a single slot, which
+** is empty. (The 'dummynode' of a process cannot be used, as its address
+** is not the same in another one.)
+*/
+static void putempty (ImageState *S) {
+  Node *n = cast(Node *, S->buff + S->empty);
+  gnext(n) = 0;
+  setnilvalue(wgkey(n));
+#if defined(LUA_SWISSTABLE)
+  setnilvalue(cast(TValue *, n + 1));
+  memcpy(cast(TValue *, n + 1) + 1, luaH_emptyctrl_, GROUPSIZE);
+#else
+  setnilvalue(gval(n));
+#endif
+}
+
+
+#define putfield(S,off,h,f,v) \
+  { (h).f = (v); if ((h).f != NULL) addreloc(S, (off) + offsetof(Table, f)); }
+
+static void puttable (ImageState *S, Table *t, size_t off) {
+  Table h = *t;
+  size_t aoff = off + imagealign(sizeof(Table));  /* array part */
+  size_t noff = aoff + t->sizearray * sizeof(TValue);  /* hash part */
+  size_t size = cast(size_t, sizenode(t));
+  unsigned int i;
+  lua_assert(t->old == NULL && t->shape == NULL && !istyped(t));
+  h.next = NULL;
+  h.gclist = NULL;
+  putfield(S, off, h, metatable, t->metatable == NULL ? NULL :
+           cast(Table *, imageaddr(S, getoffset(S, obj2gco(t->metatable)))));
+  putfield(S, off, h, array,
+           t->sizearray == 0 ? NULL : cast(TValue *, imageaddr(S, aoff)));
+  for (i = 0; i < t->sizearray; i++)
+    putvalue(S, aoff + i * sizeof(TValue), &t->array[i]);
+  if (isdummy(t))
+    noff = S->empty;
+  else {
+    Node *n;
+    memcpy(S->buff + noff, t->node, nodevecsize(size) * sizeof(Node));
+    for (n = gnode(t, 0); n < gnode(t, size); n++) {
+      size_t kat = noff + (cast(const char *, gkey(n)) - cast(char *, t->node));
+      size_t vat = noff + (cast(char *, nval(t, n)) - cast(char *, t->node));
+      if (!ttisnil(nval(t, n))) {
+        putvalue(S, kat, gkey(n));
+        putvalue(S, vat, nval(t, n));
+      }
+      else if (iscollectable(gkey(n)) || ttisdeadkey(gkey(n))) {
+        TValue k = *gkey(n);  /* its object may not be in the image */
+        setgcptr(&k, 0);
+        setdeadvalue(&k);
+        memcpy(S->buff + kat, &k, sizeof(TValue));
+      }
+    }
+  }
+  putfield(S, off, h, node, cast(Node *, imageaddr(S, noff)));
+#if defined(LUA_SWISSTABLE)
+  noff += size * sizeof(Node);  /* values come after the keys */
+  putfield(S, off, h, hvals, cast(TValue *, imageaddr(S, noff)));
+  noff += size * sizeof(TValue);  /* and control bytes after the values */
+  putfield(S, off, h, ctrl, cast(lu_byte *, imageaddr(S, noff)));
+#else
+  putfield(S, off, h, lastfree, isdummy(t) ? NULL :
+           cast(Node *, imageaddr(S, noff + size * sizeof(Node))));
+#endif
+  memcpy(S->buff + off, &h, sizeof(Table));
+}
+
+
+static void putstring (ImageState *S, TString *ts, size_t off) {
+  TString *h = cast(TString *, S->buff + off);
+  memcpy(h, ts, sizeof(UTString));
+  h->next = NULL;
+  if (ts->tt == LUA_TSHRSTR)
+    h->u.hnext = NULL;
+  else  /* a rope gets its contents right after the header */
+    h->extra &= cast_byte(~(ROPEBIT | SUBBIT));
+  memcpy(getstr(h), getstr(ts), (tsslen(ts) + 1) * sizeof(char));
+}
+
+
+static void putheader (ImageState *S, Table *root) {
+  ImageHeader *h = cast(ImageHeader *, S->buff);
+  memcpy(h->signature, LUA_IMAGESIG, sizeof(LUA_IMAGESIG));
+  imagelayout(h->layout);
+  h->luaint = LUAC_INT;
+  h->luanum = LUAC_NUM;
+  h->base = S->base;
+  h->size = S->size;
+  h->root = getoffset(S, obj2gco(root));
+  h->strs = S->strs;
+  h->nrelocs = S->nrelocs;
+  h->seed = G(S->L)->seed;
+  h->sizestrs = S->sizestrs;
+}
+
+
+static void buildimage (lua_State *L, void *ud) {
+  ImageState *S = cast(ImageState *, ud);
+  Table *root = S->root;
+  unsigned int mask;
+  int i;
+  layout(S, root);
+  S->base = luai_imagebase(G(L)->seed ^ cast(unsigned int, S->size));
+  S->buff = luaM_newvector(L, S->size, char);
+  memset(S->buff, 0, S->size);
+  putempty(S);
+  mask = cast(unsigned int, S->sizestrs - 1);
+  for (i = 0; i < S->nobjs; i++) {
+    GCObject *o = S->objs[i];
+    size_t off = getoffset(S, o);
+    if (o->tt == LUA_TTABLE)
+      puttable(S, gco2t(o), off);
+    else {
+      putstring(S, gco2ts(o), off);
+      if (o->tt == LUA_TSHRSTR) {  /* put it in the set of short strings */
+        unsigned int j = gco2ts(o)->hash & mask;
+        size_t at;
+        TString *p = cast(TString *, imageaddr(S, off));
+        while (memcpy(&p, S->buff + S->strs + j * sizeof(TString *),
+                      sizeof(TString *)), p != NULL)
+          j = (j + 1) & mask;
+        at = S->strs + j * sizeof(TString *);
+        p = cast(TString *, imageaddr(S, off));
+        memcpy(S->buff + at, &p, sizeof(TString *));
+        addreloc(S, at);
+      }
+    }
+  }
+  putheader(S, root);
+}
+
+
+static void freeimagestate (ImageState *S) {
+  luaM_freearray(S->L, S->objs, S->sizeobjs);
+  luaM_freearray(S->L, S->relocs, S->sizerelocs);
+  luaM_freearray(S->L, S->buff, S->buff ? S->size : 0);
+}
+
+
+/*
+** Dumps the frozen table 't', and everything it reaches, as a table
+** image: a single block that 'luaU_loadimage' can use in place, in any
+** process running the same build of Lua. Pointers in the image are laid
+** out for the address given by 'luai_imagebase'; the offsets of all of
+** them follow the image.
+*/
+int luaU_dumpimage (lua_State *L, Table *t, lua_Writer w, void *data) {
+  ImageState S;
+  int status;
+  lua_assert(isfrozen(t));
+  S.L = L;
+  S.root = t;
+  S.objs = NULL; S.nobjs = S.sizeobjs = 0;
+  S.relocs = NULL; S.nrelocs = S.sizerelocs = 0;
+  S.buff = NULL; S.size = 0;
+  S.offs = luaH_new(L);
+  sethvalue2s(L, L->top, S.offs);  /* anchor it */
+  luaD_inctop(L);
+  status = luaD_rawrunprotected(L, buildimage, &S);
+  if (status != LUA_OK) {
+    freeimagestate(&S);
+    luaD_throw(L, status);  /* rethrow error */
+  }
+  L->top--;  /* remove 'offs' */
+  lua_unlock(L);
+  status = (*w)(L, S.buff, S.size, data);
+  if (status == 0 && S.nrelocs > 0)
+    status = (*w)(L, S.relocs, S.nrelocs * sizeof(size_t), data);
+  lua_lock(L);
+  freeimagestate(&S);
+  return status;
+}
+
+/* }====================================================== */
@@ -18,6 +18,7 @@
 #include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 
 
@@ -118,6 +119,11 @@ Proto *luaF_newproto (lua_State *L) {
   f->p = NULL;
   f->sizep = 0;
   f->code = NULL;
+  f->slothint = NULL;
+  f->sizeslothint = 0;
+  f->mcgroup = NULL;
+  f->mcache = NULL;
+  f->sizemcache = 0;
   f->cache = NULL;
   f->sizecode = 0;
   f->lineinfo = NULL;
@@ -135,9 +141,54 @@ Proto *luaF_newproto (lua_State *L) {
   return f;
 }
 
+/*
+** 为原型中每个可以作为RK操作数的常量分配一个散列槽位提示（见
+** 'luaH_getshortstrhint'），并为OP_SELF用到的每个方法名常量分配一组方法缓存。
+** 提示按key常量而不是按指令存放：用同一个key的访问点通常也访问同样布局的表，
+** 而执行时由指令的常量下标直接得到提示，不需要从指令位置换算。必须在'code'和
+** 'k'都确定之后调用；提示的初值无关紧要，因为每次使用前都会校验该槽位上的key。
+*/
+void luaF_initslothints (lua_State *L, Proto *f) {
+  int i;
+  int nk = (f->sizek < MAXINDEXRK + 1) ? f->sizek : MAXINDEXRK + 1;
+  int ngroups = 0;
+  lua_assert(f->slothint == NULL && f->mcgroup == NULL && f->mcache == NULL);
+  f->slothint = luaM_newvector(L, nk, int);
+  f->sizeslothint = nk;
+  for (i = 0; i < nk; i++)
+    f->slothint[i] = 0;
+  for (i = 0; i < f->sizecode; i++) {  /* mark method names */
+    Instruction ins = f->code[i];
+    if (GET_OPCODE(ins) == OP_SELF && ISK(GETARG_C(ins))) {
+      if (f->mcgroup == NULL) {
+        int j;
+        f->mcgroup = luaM_newvector(L, nk, lu_byte);
+        for (j = 0; j < nk; j++)
+          f->mcgroup[j] = 0;
+      }
+      f->mcgroup[INDEXK(GETARG_C(ins))] = 1;
+    }
+  }
+  if (f->mcgroup != NULL) {
+    for (i = 0; i < nk; i++) {  /* number the marked constants */
+      if (f->mcgroup[i])
+        f->mcgroup[i] = cast_byte(ngroups++);
+    }
+    f->mcache = luaM_newvector(L, MCWAYS * ngroups, MethodCache);
+    f->sizemcache = MCWAYS * ngroups;
+    for (i = 0; i < f->sizemcache; i++)
+      f->mcache[i].mt = NULL;  /* empty entry */
+  }
+}
+
+
 //proto以及proto结构体内指针所对应的内存释放
 void luaF_freeproto (lua_State *L, Proto *f) {
   luaM_freearray(L, f->code, f->sizecode);
+  luaM_freearray(L, f->slothint, f->sizeslothint);
+  if (f->mcgroup != NULL)
+    luaM_freearray(L, f->mcgroup, f->sizeslothint);
+  luaM_freearray(L, f->mcache, f->sizemcache);
   luaM_freearray(L, f->p, f->sizep);
   luaM_freearray(L, f->k, f->sizek);
   luaM_freearray(L, f->lineinfo, f->sizelineinfo);
@@ -80,7 +80,8 @@
 
 //key不为死key，或者value 为nil
 //故死key格式是key为LUA_TDEADKEY，同时value为nil
-#define checkdeadkey(n)	lua_assert(!ttisdeadkey(gkey(n)) || ttisnil(gval(n)))
+#define checkdeadkey(h,n) \
+	lua_assert(!ttisdeadkey(gkey(n)) || ttisnil(nval(h,n)))
 
 
 #define checkconsistency(obj)  \
@@ -114,6 +115,15 @@ static void reallymarkobject (global_State *g, GCObject *o);
 */
 #define gnodelast(h)	gnode(h, cast(size_t, sizenode(h)))
 
+/*
+** iterate 'n' over the nodes of the hash part of 'h' and then, while
+** that is being resized incrementally, over the ones of its old hash
+** part; 'p' is the part where 'n' is
+*/
+#define fornodes(h,p,n) \
+  for (p = (h); p != NULL; p = p->old) \
+    for (n = gnode(p, 0); n < gnodelast(p); n++)
+
 
 /*
 ** link collectable object 'o' into list pointed by 'p'
@@ -132,8 +142,9 @@ static void reallymarkobject (global_State *g, GCObject *o);
 ** empty.
 */
 //node的value为nil的前提下，key为白色，将key的类型设为dead
-static void removeentry (Node *n) {
-  lua_assert(ttisnil(gval(n)));
+static void removeentry (Table *h, Node *n) {
+  lua_assert(ttisnil(nval(h, n)));
+  (void)h;  /* only for the assertion */
   if (valiswhite(gkey(n)))
     setdeadvalue(wgkey(n));  /* unused and unmarked key; remove it */
 }
@@ -216,6 +227,171 @@ void luaC_fix (lua_State *L, GCObject *o) {
 }
 
 
+static void takefrozen (GCObject **p, GCObject **list) {
+  while (*p != NULL) {
+    GCObject *curr = *p;
+    if (!isfrozen(curr))
+      p = &curr->next;
+    else if (list == NULL) {  /* freezing failed? */
+      resetbit(curr->marked, FROZENBIT);
+      p = &curr->next;
+    }
+    else {
+      *p = curr->next;  /* remove 'curr' from the list */
+      curr->marked = bitmask(FROZENBIT);  /* no color: never marked */
+      curr->next = *list;  /* link it to 'list' */
+      *list = curr;
+    }
+  }
+}
+
+
+/*
+** 把带FROZENBIT的对象（冻结表映像中新的表和字符串，见'luaH_freeze'）从GC
+** 链表中取出，链到'list'；'list'为NULL时只清除FROZENBIT。只在GCSpause
+** 状态调用，此时没有清扫进行到一半的链表。
+*/
+void luaC_takefrozen (lua_State *L, GCObject **list) {
+  global_State *g = G(L);
+  lua_assert(g->gcstate == GCSpause);
+  takefrozen(&g->allgc, list);
+  takefrozen(&g->finobj, list);
+  takefrozen(&g->fixedgc, list);
+}
+
+
+/* if 'o' is a replaced string (see 'isreplaced'), make it the new one */
+static void replacevalue (TValue *o) {
+  if (iscollectable(o) && isreplaced(gcvalue(o)))
+    val_(o).gc = obj2gco(gco2ts(gcvalue(o))->u.hnext);
+}
+
+
+static void replacestr (TString **ts) {
+  if (*ts != NULL && isreplaced(obj2gco(*ts)))
+    *ts = (*ts)->u.hnext;
+}
+
+
+static void replaceinobj (GCObject *o) {
+  int i;
+  switch (o->tt) {
+    case LUA_TTABLE: {
+      Table *h = gco2t(o);
+      Table *p;
+      Node *n;
+      unsigned int j;
+      for (j = 0; j < h->sizearray; j++)
+        replacevalue(&h->array[j]);
+      if (isshaped(h)) {
+        for (i = 0; i < h->shape->nkeys; i++)
+          replacevalue(&h->svals[i]);
+      }
+      fornodes(h, p, n) {  /* (dead keys may refer to freed objects) */
+        if (!ttisdeadkey(gkey(n)))
+          replacevalue(cast(TValue *, gkey(n)));
+        replacevalue(nval(p, n));
+      }
+      break;
+    }
+    case LUA_TUSERDATA: {
+      Udata *u = gco2u(o);
+      TValue uv;
+      uv.value_ = u->user_; settt_(&uv, u->ttuv_);
+      replacevalue(&uv);
+      u->user_ = uv.value_;
+      break;
+    }
+    case LUA_TLCL: {  /* open upvalues are in the stacks */
+      LClosure *cl = gco2lcl(o);
+      for (i = 0; i < cl->nupvalues; i++) {
+        if (cl->upvals[i] != NULL && !upisopen(cl->upvals[i]))
+          replacevalue(cl->upvals[i]->v);
+      }
+      break;
+    }
+    case LUA_TCCL: {
+      CClosure *cl = gco2ccl(o);
+      for (i = 0; i < cl->nupvalues; i++)
+        replacevalue(&cl->upvalue[i]);
+      break;
+    }
+    case LUA_TPROTO: {
+      Proto *f = gco2p(o);
+      replacestr(&f->source);
+      for (i = 0; i < f->sizek; i++)
+        replacevalue(&f->k[i]);
+      for (i = 0; i < f->sizeupvalues; i++)
+        replacestr(&f->upvalues[i].name);
+      for (i = 0; i < f->sizelocvars; i++)
+        replacestr(&f->locvars[i].varname);
+      break;
+    }
+    case LUA_TTHREAD: {
+      lua_State *th = gco2th(o);
+      StkId v;
+      if (th->stack != NULL) {
+        for (v = th->stack; v < th->top; v++)
+          replacevalue(v);
+      }
+      break;
+    }
+    default: break;  /* strings refer to tables and long strings only */
+  }
+}
+
+
+/* frees the replaced strings in list 'p' */
+static void freereplaced (lua_State *L, GCObject **p) {
+  while (*p != NULL) {
+    GCObject *curr = *p;
+    if (!isreplaced(curr))
+      p = &curr->next;
+    else {  /* already out of 'strt' */
+      *p = curr->next;
+      luaM_freemem(L, curr, sizelstring(gco2ts(curr)->shrlen));
+    }
+  }
+}
+
+
+/*
+** Makes every reference of the state to a replaced string (see
+** 'isreplaced') refer to its replacement, then frees the replaced
+** strings. Only called in GCSpause, without allocating.
+*/
+void luaC_replacestrings (lua_State *L) {
+  global_State *g = G(L);
+  GCObject *lists[4];
+  GCObject *o;
+  int i, j;
+  lua_assert(g->gcstate == GCSpause);
+  lists[0] = g->allgc; lists[1] = g->finobj;
+  lists[2] = g->tobefnz; lists[3] = g->fixedgc;
+  for (i = 0; i < 4; i++) {
+    for (o = lists[i]; o != NULL; o = o->next)
+      replaceinobj(o);
+  }
+  replaceinobj(obj2gco(g->mainthread));
+  for (i = 0; i < g->shapes.size; i++) {
+    Shape *sh;
+    for (sh = g->shapes.hash[i]; sh != NULL; sh = sh->hnext) {
+      for (j = 0; j < sh->nkeys; j++)  /* same hash: the shape stays put */
+        replacestr(&sh->keys[j]);
+    }
+  }
+  replacestr(&g->memerrmsg);
+  for (i = 0; i < TM_N; i++)
+    replacestr(&g->tmname[i]);
+  for (i = 0; i < STRCACHE_N; i++) {
+    for (j = 0; j < STRCACHE_M; j++)
+      replacestr(&g->strcache[i][j]);
+  }
+  freereplaced(L, &g->allgc);
+  freereplaced(L, &g->fixedgc);
+}
+
+
 /*
 ** create a new collectable object (with given type and size) and link
 ** it to 'allgc' list.
@@ -267,8 +443,20 @@ static void reallymarkobject (global_State *g, GCObject *o) {
       break;
     }
     case LUA_TLNGSTR: {
+      TString *ts = gco2ts(o);
       gray2black(o);//由于TString不可能包含子节点，因此可以在propagate阶段直接标记为黑色
-      g->GCmemtrav += sizelstring(gco2ts(o)->u.lnglen);
+      if (!isrope(ts))
+        g->GCmemtrav += sizelstring(ts->u.lnglen);
+      else {  /* a rope keeps its pieces (if not flattened yet) */
+        g->GCmemtrav += sizerope;
+        if (getrope(ts)->flat != NULL)
+          g->GCmemtrav += ts->u.lnglen + 1;
+        else if (issub(ts)) {  /* a view keeps its source */
+          markobject(g, getrope(ts)->u.src);
+        }
+        else
+          markobject(g, getrope(ts)->u.buf);
+      }
       break;
     }
     case LUA_TUSERDATA: {
@@ -307,6 +495,15 @@ static void reallymarkobject (global_State *g, GCObject *o) {
       linkgclist(gco2p(o), g->gray);
       break;
     }
+    case LUA_TSHAPE: {  /* 形状只引用短字符串，直接标记为黑色 */
+      Shape *sh = gco2sh(o);
+      int i;
+      for (i = 0; i < sh->nkeys; i++)
+        markobject(g, sh->keys[i]);
+      gray2black(o);
+      g->GCmemtrav += sizeshape(sh->nkeys);
+      break;
+    }
     default: lua_assert(0); break;
   }
 }
@@ -390,6 +587,28 @@ static void restartcollection (global_State *g) {
 ** =======================================================
 */
 
+/*
+** Check whether table 'h', with 'live' slots in use, should be shrunk
+** when swept (see 'shrinktable'). Only done while propagating (a table
+** may be traversed again in the atomic phase).
+*/
+//大部分槽位是空的表标记SHRINKBIT（已恢复的表清除该位），由sweep阶段收缩
+static void checkshrink (global_State *g, Table *h, lu_mem live) {
+  lu_mem size = h->sizearray + allocsizenode(h);
+  if (g->gcstate != GCSpropagate)
+    return;
+  if (istyped(h)) {  /* typed array part is not traversed */
+    size += typedarray(h)->size;
+    live += typedarray(h)->n;
+  }
+  if (size >= LUAI_MINSHRINK && live < size / 4 &&
+      h->old == NULL && !isshaped(h))
+    l_setbit(h->marked, SHRINKBIT);
+  else
+    resetbit(h->marked, SHRINKBIT);
+}
+
+
 /*
 ** Traverse a table with weak values and link it to proper list. During
 ** propagate phase, keep it in 'grayagain' list, to be revisited in the
@@ -400,24 +619,28 @@ static void restartcollection (global_State *g) {
 //在GCSpropagate阶段，放到g->grayagain，value相关处理放到GCSatomic处理。
 //在GCSatomic，任何value为白色，就放到weak
 static void traverseweakvalue (global_State *g, Table *h) {
-  Node *n, *limit = gnodelast(h);
-  /* if there is array part, assume it may have white values (it is not
-     worth traversing it now just to check) */
-  int hasclears = (h->sizearray > 0);
-  for (n = gnode(h, 0); n < limit; n++) {  /* traverse hash part */
-    checkdeadkey(n);
-    if (ttisnil(gval(n)))  /* entry is empty? */
+  Node *n;
+  Table *p;
+  lu_mem live = h->sizearray;  /* array part counted as full */
+  /* if there is array part (or shape values), assume it may have white
+     values (it is not worth traversing it now just to check) */
+  int hasclears = (h->sizearray > 0 || isshaped(h));
+  fornodes(h, p, n) {  /* traverse hash part */
+    checkdeadkey(p, n);
+    if (ttisnil(nval(p, n)))  /* entry is empty? */
       //若value为nil，key就没有存在必要，将key的类型设为dead
-      removeentry(n);  /* remove it */
+      removeentry(p, n);  /* remove it */
     else {
       lua_assert(!ttisnil(gkey(n)));
       //强key白变灰
       markvalue(g, gkey(n));  /* mark key */
-      if (!hasclears && iscleared(g, gval(n)))  /* is there a white value? */
+      live++;
+      if (!hasclears && iscleared(g, nval(p, n)))  /* is there a white value? */
         //弱value为白
         hasclears = 1;  /* table will have to be cleared */
     }
   }
+  checkshrink(g, h, live);
   //可能在GCSpropagate，也可能在GCSatomic
   if (g->gcstate == GCSpropagate)
     //GCSpropagate，放到grayagain
@@ -444,35 +667,50 @@ static int traverseephemeron (global_State *g, Table *h) {
   int marked = 0;  /* true if an object is marked in this traversal */
   int hasclears = 0;  /* true if table has white keys */
   int hasww = 0;  /* true if table has entry "white-key -> white-value" */
-  Node *n, *limit = gnodelast(h);
+  lu_mem live = 0;  /* number of non-empty slots */
+  Node *n;
+  Table *p;
   unsigned int i;
   /* traverse array part */
   //没有弱key的arry，所以正常处理即可
   for (i = 0; i < h->sizearray; i++) {
+    if (!ttisnil(&h->array[i]))
+      live++;
     if (valiswhite(&h->array[i])) {
       marked = 1;
       reallymarkobject(g, gcvalue(&h->array[i]));
     }
   }
+  if (isshaped(h)) {  /* shape keys are strings, never weak */
+    for (i = 0; i < h->shape->nkeys; i++) {
+      if (valiswhite(&h->svals[i])) {
+        marked = 1;
+        reallymarkobject(g, gcvalue(&h->svals[i]));
+      }
+    }
+  }
   /* traverse hash part */
-  for (n = gnode(h, 0); n < limit; n++) {
-    checkdeadkey(n);
-    if (ttisnil(gval(n)))  /* entry is empty? */
+  fornodes(h, p, n) {
+    checkdeadkey(p, n);
+    if (!ttisnil(nval(p, n)))
+      live++;
+    if (ttisnil(nval(p, n)))  /* entry is empty? */
       //若value为nil，key就没有存在必要，将key的类型设为dead
-      removeentry(n);  /* remove it */
+      removeentry(p, n);  /* remove it */
     else if (iscleared(g, gkey(n))) {  /* key is not marked (yet)? */
       //弱key为白色，value就要被清理
       hasclears = 1;  /* table must be cleared */
-      if (valiswhite(gval(n)))  /* value not marked yet? */
+      if (valiswhite(nval(p, n)))  /* value not marked yet? */
         //弱key和value都是白色
         hasww = 1;  /* white-white entry */
     }
-    else if (valiswhite(gval(n))) {  /* value not marked yet? */
+    else if (valiswhite(nval(p, n))) {  /* value not marked yet? */
       //弱key为灰色并且value为白色，和强表处理一致故白色的value要变灰
       marked = 1;
-      reallymarkobject(g, gcvalue(gval(n)));  /* mark it now */
+      reallymarkobject(g, gcvalue(nval(p, n)));  /* mark it now */
     }
   }
+  checkshrink(g, h, live);
   /* link table into proper list */
   if (g->gcstate == GCSpropagate)
     linkgclist(h, g->grayagain);  /* must retraverse it in atomic phase */
@@ -487,32 +725,47 @@ static int traverseephemeron (global_State *g, Table *h) {
 
 //表刚已gray设为black，故遍历表array和hash部分，元素白变灰
 static void traversestrongtable (global_State *g, Table *h) {
-  Node *n, *limit = gnodelast(h);
+  Node *n;
+  Table *p;
   unsigned int i;
-  for (i = 0; i < h->sizearray; i++)  /* traverse array part */
+  lu_mem live = 0;  /* number of non-empty slots */
+  for (i = 0; i < h->sizearray; i++) {  /* traverse array part */
+    if (!ttisnil(&h->array[i]))
+      live++;
     markvalue(g, &h->array[i]);
-  for (n = gnode(h, 0); n < limit; n++) {  /* traverse hash part */
-    checkdeadkey(n);
-    if (ttisnil(gval(n)))  /* entry is empty? */
+  }
+  if (isshaped(h)) {  /* traverse shape values (keys are in the shape) */
+    for (i = 0; i < h->shape->nkeys; i++)
+      markvalue(g, &h->svals[i]);
+  }
+  fornodes(h, p, n) {  /* traverse hash part */
+    checkdeadkey(p, n);
+    if (ttisnil(nval(p, n)))  /* entry is empty? */
       //若value为nil，key就没有存在必要，将key的类型设为dead
-      removeentry(n);  /* remove it */
+      removeentry(p, n);  /* remove it */
     else {
       lua_assert(!ttisnil(gkey(n)));
       markvalue(g, gkey(n));  /* mark key */
-      markvalue(g, gval(n));  /* mark value */
+      markvalue(g, nval(p, n));  /* mark value */
+      live++;
     }
   }
+  checkshrink(g, h, live);
 }
 
+/* '__mode' may be a rope not flattened yet, which cannot be flattened here */
+#define modechr(ts,c)	(islazy(ts) ? luaS_ropechr(ts, c) : strchr(getstr(ts), c))
+
 //表刚从gray设为black，故需要遍历表中的元表、array和hash部分，设置为gray
 static lu_mem traversetable (global_State *g, Table *h) {
   const char *weakkey, *weakvalue;
   const TValue *mode = gfasttm(g, h->metatable, TM_MODE);
   //元表白变灰
   markobjectN(g, h->metatable);
+  markobjectN(g, h->shape);
   if (mode && ttisstring(mode) &&  /* is there a weak mode? */
-      ((weakkey = strchr(svalue(mode), 'k')),
-       (weakvalue = strchr(svalue(mode), 'v')),
+      ((weakkey = modechr(tsvalue(mode), 'k')),
+       (weakvalue = modechr(tsvalue(mode), 'v')),
        (weakkey || weakvalue))) {  /* is really weak? */
     //弱表情况下，保持灰，并放到不同的移到weak、ephemeron、allweak后等待处理
     black2gray(h);  /* keep table gray */
@@ -526,8 +779,11 @@ static lu_mem traversetable (global_State *g, Table *h) {
   }
   else  /* not weak */
     traversestrongtable(g, h);
-  return sizeof(Table) + sizeof(TValue) * h->sizearray +
-                         sizeof(Node) * cast(size_t, allocsizenode(h));
+  return sizeof(Table) + arraybytes(h) +
+         sizeof(Node) * nodevecsize(cast(size_t, allocsizenode(h))) +
+         (isshaped(h) ? sizeof(TValue) * shapecap(h->shape->nkeys) : 0) +
+         (h->old ? sizeof(Node) * nodevecsize(cast(size_t, sizenode(h->old)))
+                 : 0);
 }
 
 
@@ -551,6 +807,9 @@ static int traverseproto (global_State *g, Proto *f) {
   for (i = 0; i < f->sizelocvars; i++)  /* mark local-variable names */
     markobjectN(g, f->locvars[i].varname);
   return sizeof(Proto) + sizeof(Instruction) * f->sizecode +
+                         sizeof(int) * f->sizeslothint +
+                         (f->mcgroup ? f->sizeslothint : 0) +
+                         sizeof(MethodCache) * f->sizemcache +
                          sizeof(Proto *) * f->sizep +
                          sizeof(TValue) * f->sizek +
                          sizeof(int) * f->sizelineinfo +
@@ -717,15 +976,16 @@ static void convergeephemerons (global_State *g) {
 static void clearkeys (global_State *g, GCObject *l, GCObject *f) {
   for (; l != f; l = gco2t(l)->gclist) {
     Table *h = gco2t(l);
-    Node *n, *limit = gnodelast(h);
-    for (n = gnode(h, 0); n < limit; n++) {
-      if (!ttisnil(gval(n)) && (iscleared(g, gkey(n)))) {
+    Node *n;
+    Table *p;
+    fornodes(h, p, n) {
+      if (!ttisnil(nval(p, n)) && (iscleared(g, gkey(n)))) {
         //弱key table的特征：弱key为白，value置为空，解除引用
-        setnilvalue(gval(n));  /* remove value ... */
+        setnilvalue(nval(p, n));  /* remove value ... */
       }
-      if (ttisnil(gval(n)))  /* is entry empty? */
+      if (ttisnil(nval(p, n)))  /* is entry empty? */
         //若value为nil，key就没有存在必要，将key的类型设为dead
-        removeentry(n);  /* remove entry from table */
+        removeentry(p, n);  /* remove entry from table */
     }
   }
 }
@@ -740,7 +1000,8 @@ static void clearkeys (global_State *g, GCObject *l, GCObject *f) {
 static void clearvalues (global_State *g, GCObject *l, GCObject *f) {
   for (; l != f; l = gco2t(l)->gclist) {
     Table *h = gco2t(l);
-    Node *n, *limit = gnodelast(h);
+    Node *n;
+    Table *p;
     unsigned int i;
     for (i = 0; i < h->sizearray; i++) {
       TValue *o = &h->array[i];
@@ -748,12 +1009,19 @@ static void clearvalues (global_State *g, GCObject *l, GCObject *f) {
         //弱value为白色，则value置为空解除引用。
         setnilvalue(o);  /* remove value */ 
     }
-    for (n = gnode(h, 0); n < limit; n++) {
-      if (!ttisnil(gval(n)) && iscleared(g, gval(n))) {
+    if (isshaped(h)) {
+      for (i = 0; i < h->shape->nkeys; i++) {
+        TValue *o = &h->svals[i];
+        if (iscleared(g, o))  /* value was collected? */
+          setnilvalue(o);  /* remove value (slot stays in the shape) */
+      }
+    }
+    fornodes(h, p, n) {
+      if (!ttisnil(nval(p, n)) && iscleared(g, nval(p, n))) {
         //弱value为白色，则value置为空解除引用，和进行dead key标识。
-        setnilvalue(gval(n));  /* remove value ... */
+        setnilvalue(nval(p, n));  /* remove value ... */
         //若value为nil，key就没有存在必要，将key的类型设为dead
-        removeentry(n);  /* and remove entry from table */
+        removeentry(p, n);  /* and remove entry from table */
       }
     }
   }
@@ -800,7 +1068,14 @@ static void freeobj (lua_State *L, GCObject *o) {
       luaM_freemem(L, o, sizelstring(gco2ts(o)->shrlen));
       break;
     case LUA_TLNGSTR: {
-      luaM_freemem(L, o, sizelstring(gco2ts(o)->u.lnglen));
+      TString *ts = gco2ts(o);
+      if (!isrope(ts))
+        luaM_freemem(L, o, sizelstring(ts->u.lnglen));
+      else {
+        luaM_freearray(L, getrope(ts)->flat,
+                       getrope(ts)->flat ? ts->u.lnglen + 1 : 0);
+        luaM_freemem(L, o, sizerope);
+      }
       break;
     }
     default: lua_assert(0);
@@ -812,6 +1087,34 @@ static void freeobj (lua_State *L, GCObject *o) {
 static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count);
 
 
+static void doshrink (lua_State *L, void *ud) {
+  luaH_shrink(L, cast(Table *, ud), NULL);
+}
+
+
+/*
+** Shrink a table marked with SHRINKBIT, unless a traversal by 'next'
+** may be running over it ('ntrav'): a shrink would lose the keys of
+** entries erased during the traversal and reorder the others. Such a
+** table keeps the bit and is shrunk at its next new key instead.
+** Errors are ignored (the table is left as it was) and emergency
+** collections are stopped, as the collector is running. Returns the
+** number of slots visited, to be charged to the sweep.
+*/
+//sweep阶段收缩大部分为空、没有在被遍历的表，返回访问过的槽位数
+static lu_mem shrinktable (lua_State *L, Table *h) {
+  global_State *g = G(L);
+  lu_mem work = h->sizearray + allocsizenode(h);
+  if (g->gckind != KGC_EMERGENCY && h->ntrav == 0) {
+    lu_byte oldstopem = g->gcstopem;
+    g->gcstopem = 1;  /* avoid a collection inside the collector */
+    luaD_rawrunprotected(L, doshrink, h);
+    g->gcstopem = oldstopem;
+  }
+  return work;
+}
+
+
 /*
 ** sweep at most 'count' elements from a list of GCObjects erasing dead
 ** objects, where a dead object is one marked with the old (non current)
@@ -835,6 +1138,11 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
     else {  /* change mark to 'white' */
       //不清理的，需要换白色
       curr->marked = cast_byte((marked & maskcolors) | white);
+      if (testbit(marked, SHRINKBIT)) {  /* table to be shrunk? */
+        /* already white, so that reinserting keys needs no barriers */
+        lu_mem work = shrinktable(L, gco2t(curr)) / GCSWEEPCOST;
+        count = (count > work) ? count - work : 0;
+      }
       p = &curr->next;  /* go to next element */
     }
   }
@@ -863,14 +1171,50 @@ static GCObject **sweeptolive (lua_State *L, GCObject **p) {
 */
 
 /*
-** If possible, shrink string table
+** Sweep all table shapes. Shapes are not in 'allgc': they are swept
+** in one go at the end of the sweep phase, after every table that may
+** have used them, so that 'luaH_free' can still read their sizes.
+*/
+static void sweepshapes (lua_State *L, global_State *g) {
+  shapetable *tb = &g->shapes;
+  int ow = otherwhite(g);
+  int white = luaC_white(g);  /* current white */
+  l_mem olddebt = g->GCdebt;
+  int i;
+  for (i = 0; i < tb->size; i++) {
+    Shape **p = &tb->hash[i];
+    while (*p != NULL) {
+      Shape *curr = *p;
+      int marked = curr->marked;
+      if (isdeadm(ow, marked)) {  /* is 'curr' dead? */
+        *p = curr->hnext;  /* remove 'curr' from list */
+        tb->nuse--;
+        luaM_freemem(L, curr, sizeshape(curr->nkeys));
+      }
+      else {  /* change mark to 'white' */
+        curr->marked = cast_byte((marked & maskcolors) | white);
+        p = &curr->hnext;
+      }
+    }
+  }
+  g->GCestimate += g->GCdebt - olddebt;  /* update estimate */
+}
+
+
+/*
+** If possible, shrink string table (and shape table)
 */
 static void checkSizes (lua_State *L, global_State *g) {
   if (g->gckind != KGC_EMERGENCY) {
     l_mem olddebt = g->GCdebt;
     
-    if (g->strt.nuse < g->strt.size / 4)  /* string table too big? */
+    if (g->strt.nuse < g->strt.size / 4 &&  /* string table too big? */
+        g->strt.old == NULL)  /* (and not being resized already) */
       luaS_resize(L, g->strt.size / 2);  /* shrink it a little */
+
+    if (g->shapes.nuse < g->shapes.size / 4 &&
+        g->shapes.size > MINSHAPETABSIZE)  /* shape table too big? */
+      luaH_resizeshapes(L, g->shapes.size / 2);
     
     g->GCestimate += g->GCdebt - olddebt;  /* update estimate */
   }
@@ -923,9 +1267,13 @@ static void GCTM (lua_State *L, int propagateerrors) {
     g->gcrunning = running;  /* restore state */
     if (status != LUA_OK && propagateerrors) {  /* error while running __gc? */
       if (status == LUA_ERRRUN) {  /* is there an error object? */
-        const char *msg = (ttisstring(L->top - 1))
-                            ? svalue(L->top - 1)
-                            : "no message";
+        const char *msg;
+        if (ttisstring(L->top - 1)) {
+          luaS_flatvalue(L, L->top - 1);
+          msg = svalue(L->top - 1);
+        }
+        else
+          msg = "no message";
         luaO_pushfstring(L, "error in __gc metamethod (%s)", msg);
         status = LUA_ERRGCMM;  /* error in __gc metamethod */
       }
@@ -1222,6 +1570,7 @@ static lu_mem singlestep (lua_State *L) {
     //（一步完成）
     case GCSswpend: {  /* finish sweeps */
       makewhite(g, g->mainthread);  /* sweep main thread */
+      sweepshapes(L, g);
       checkSizes(L, g);
       g->gcstate = GCScallfin;
       return 0;
@@ -1279,6 +1628,8 @@ void luaC_step (lua_State *L) {
     luaE_setdebt(g, -GCSTEPSIZE * 10);  /* avoid being called too often */
     return;
   }
+  if (g->strt.old != NULL)  /* string table being resized? */
+    luaS_movestrings(L, cast_int(GCSTEPSIZE / sizeof(TString *)));
   //gcstate等于GCSpause的话，说明本轮gc已经彻底完结，即将进入下一个gc轮回中
   //每次触发luaC_step函数，只会处理至多debt+GCSTEPSIZE个字节的数据
   do {  /* repeat until pause or enough "credit" (negative debt) */
@@ -1319,6 +1670,11 @@ void luaC_fullgc (lua_State *L, int isemergency) {
   //完成GCSpause的工作
   luaC_runtilstate(L, ~bitmask(GCSpause));  /* start new collection */
   luaC_runtilstate(L, bitmask(GCScallfin));  /* run up to finalizers */
+  if (g->strt.old != NULL) {  /* string table being resized? */
+    l_mem olddebt = g->GCdebt;
+    luaS_movestrings(L, g->strt.oldsize);  /* a full cycle finishes it */
+    g->GCestimate += g->GCdebt - olddebt;  /* update estimate */
+  }
   /* estimate must be correct after a full GC cycle */
   lua_assert(g->GCestimate == gettotalbytes(g));
   luaC_runtilstate(L, bitmask(GCSpause));  /* finish collection */
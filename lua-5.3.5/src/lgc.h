@@ -102,6 +102,13 @@
 #define BLACKBIT	2  /* object is black */
 //table和UserData设置元表的情况下，多一种状态
 #define FINALIZEDBIT	3  /* object has been marked for finalization */
+//遍历时发现表的大部分槽位是空的，清扫到它时缩小（见shrinktable），
+//有进行中的遍历时留到下次插入新key时（见luaH_newkey）
+#define SHRINKBIT	4  /* table is to be shrunk when swept */
+//冻结表映像中的对象（见ltable.c）：没有颜色，不在任何GC链表上，GC既不标记也不回收
+#define FROZENBIT	5  /* object belongs to a frozen table image */
+//表的数组部分在当前大小下已经试过不能转换成类型化数组（见luaH_trytype）
+#define NOTYPEBIT	6  /* array part not to be typed at its current size */
 /* bit 7 is currently used by tests (luaL_checkmemory) */
 
 #define WHITEBITS	bit2mask(WHITE0BIT, WHITE1BIT)
@@ -112,6 +119,14 @@
 #define isgray(x)  /* neither white nor black */  \
 	(!testbits((x)->marked, WHITEBITS | bitmask(BLACKBIT)))
 #define tofinalize(x)	testbit((x)->marked, FINALIZEDBIT)
+#define isfrozen(x)	testbit((x)->marked, FROZENBIT)
+
+/*
+** a short string being replaced by an equal string of a frozen table
+** image (see 'luaS_adopt'): it is black while the collector is paused,
+** when no other object is, and its 'u.hnext' is the replacement
+*/
+#define isreplaced(x)	((x)->tt == LUA_TSHRSTR && isblack(x))
 
 //获取当前状态的otherwhite。eg，当前为1，otherwhite为0
 #define otherwhite(g)	((g)->currentwhite ^ WHITEBITS)
@@ -180,6 +195,8 @@
          luaC_upvalbarrier_(L,uv) : cast_void(0))
 
 LUAI_FUNC void luaC_fix (lua_State *L, GCObject *o);
+LUAI_FUNC void luaC_takefrozen (lua_State *L, GCObject **list);
+LUAI_FUNC void luaC_replacestrings (lua_State *L);
 LUAI_FUNC void luaC_freeallobjects (lua_State *L);
 LUAI_FUNC void luaC_step (lua_State *L);
 LUAI_FUNC void luaC_runtilstate (lua_State *L, int statesmask);
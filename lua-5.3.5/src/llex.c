@@ -148,8 +148,10 @@ TString *luaX_newstring (LexState *ls, const char *str, size_t l) {
     setbvalue(o, 1);  /* t[string] = true */
     luaC_checkGC(L);
   }
-  else {  /* string already present */
-    ts = tsvalue(keyfromval(o));  /* re-use value previously stored */
+  else if (ts->tt == LUA_TLNGSTR) {  /* long string already present? */
+    /* short strings are internalized already (and 'ls->h' may keep
+       them in a shape, where there is no key to recover) */
+    ts = tsvalue(keyfromval(ls->h, o));  /* re-use value previously stored */
   }
   L->top--;  /* remove string from stack */
   return ts;
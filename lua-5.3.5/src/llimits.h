@@ -35,6 +35,14 @@ typedef long l_mem;
 typedef unsigned char lu_byte;
 
 
+/* an unsigned integer with at least 32 bits */
+#if LUAI_BITSINT >= 32
+typedef unsigned int l_uint32;
+#else
+typedef unsigned long l_uint32;
+#endif
+
+
 /* maximum value for size_t */
 #define MAX_SIZET	((size_t)(~(size_t)0))
 
@@ -190,6 +198,81 @@ typedef unsigned long Instruction;
 #endif
 
 
+/*
+** Minimum size of the string table (before or after a resize) that is
+** resized incrementally: its strings move to the new buckets a few
+** buckets at a time, as new strings are created and as the collector
+** runs, instead of all at once (see 'luaS_resize').
+*/
+#if !defined(LUAI_MINSTRTMOVE)
+#define LUAI_MINSTRTMOVE	(1 << 16)
+#endif
+
+
+/*
+** Maximum number of keys in a table shape; a table that gets more
+** (or any key that is not a short string) in its hash part goes back
+** to the usual 'Node' representation. Must fit in a 'lu_byte'.
+*/
+#if !defined(MAXSHAPEKEYS)
+#define MAXSHAPEKEYS	16
+#endif
+
+/* initial size for the table of shapes (must be power of 2) */
+#if !defined(MINSHAPETABSIZE)
+#define MINSHAPETABSIZE	32
+#endif
+
+
+/*
+** Minimum length for the result of a concatenation to be built as a
+** rope (see 'luaS_newrope'), that is, without copying its contents.
+** Must be larger than LUAI_MAXSHORTLEN.
+*/
+#if !defined(LUAI_MINROPE)
+#define LUAI_MINROPE	256
+#endif
+
+
+/*
+** Minimum length for a substring (as those from 'string.sub' and from
+** pattern captures) to be built as a view into its source string (see
+** 'luaS_newsub'), that is, without copying its contents. Must be larger
+** than LUAI_MAXSHORTLEN.
+*/
+#if !defined(LUAI_MINVIEW)
+#define LUAI_MINVIEW	128
+#endif
+
+
+/*
+** Minimum size of an array part that can be turned into a typed array,
+** with unboxed integers or floats (see LUA_TYPEDARRAY in 'luaconf.h').
+*/
+#if !defined(LUAI_MINTYPED)
+#define LUAI_MINTYPED	64
+#endif
+
+
+/*
+** Minimum size of a hash part that is resized incrementally: its nodes
+** move to the new hash part a few at a time, as new keys are inserted,
+** instead of all at once (see 'startmove' in 'ltable.c').
+*/
+#if !defined(LUAI_MINHASHMOVE)
+#define LUAI_MINHASHMOVE	(1 << 14)
+#endif
+
+
+/*
+** Minimum number of slots (array plus hash part) of a table that the
+** collector shrinks when at most a quarter of them are in use.
+*/
+#if !defined(LUAI_MINSHRINK)
+#define LUAI_MINSHRINK		1024
+#endif
+
+
 /*
 ** Size of cache for strings in the API. 'N' is the number of
 ** sets (better be a prime) and "M" is the size of each set (M == 1
@@ -201,6 +284,40 @@ typedef unsigned long Instruction;
 #endif
 
 
+/*
+** Increment/decrement (returning the new value) of the reference count
+** of a frozen table image, which states running in different threads
+** may share. Without GCC atomics the host must serialize the calls to
+** 'lua_pushfrozen', 'lua_releasefrozen' and 'lua_close' of such states.
+*/
+#if !defined(luai_refinc)
+#if defined(__GNUC__)
+#define luai_refinc(r)	__atomic_add_fetch(&(r), 1, __ATOMIC_ACQ_REL)
+#define luai_refdec(r)	__atomic_sub_fetch(&(r), 1, __ATOMIC_ACQ_REL)
+#else
+#define luai_refinc(r)	(++(r))
+#define luai_refdec(r)	(--(r))
+#endif
+#endif
+
+
+/*
+** Address for which a table image is laid out (see 'luaU_dumpimage'):
+** one of 256 slots of 4 GB, picked by a hash 'h' of the image. A loader
+** that maps the image at that address uses it as it is, sharing its
+** pages with every other process that does the same; anywhere else the
+** image must be relocated first. (Without 64-bit addresses images are
+** laid out for address 0, that is, always relocated.)
+*/
+#if !defined(luai_imagebase)
+#if defined(__LP64__) || defined(_WIN64)
+#define luai_imagebase(h)	(cast(size_t, 0x5a00u + ((h) & 0xffu)) << 32)
+#else
+#define luai_imagebase(h)	cast(size_t, 0)
+#endif
+#endif
+
+
 /* minimum size for string buffer */
 #if !defined(LUA_MINBUFFER)
 #define LUA_MINBUFFER	32
@@ -21,6 +21,7 @@
 */
 #define LUA_TPROTO	LUA_NUMTAGS		/* function prototypes */
 #define LUA_TDEADKEY	(LUA_NUMTAGS+1)		/* removed keys in tables */
+#define LUA_TSHAPE	(LUA_NUMTAGS+2)		/* table shapes */
 
 /* 原始的数据类型只要用低四位就可以表示了，因为原始数据类型不超过16种 */
 
@@ -407,7 +408,7 @@ typedef struct TString {
   */
 //   TString为长字符串时：当extra=0表示该字符串未进行hash运算；当extra=1时表示该字符串已经进行过hash运算。
 //   TString为短字符串时：当extra=0时表示它需要被gc托管；当extra=1时表示该字符串不会被gc回收。
-  lu_byte extra;  /* reserved words for short strings; "has hash" for longs */
+  lu_byte extra;  /* reserved words for short strings; "has hash" (and ROPEBIT, SUBBIT) for longs */
   /* 由于Lua不以'\0'来识别字符串的长度，因此需要显示保存字符串的长度。 */
   lu_byte shrlen;  /* length for short strings */ /* 短字符串的长度 */
   unsigned int hash;	/* 该string对应的hash值，由string进行hash后得到 */
@@ -434,16 +435,59 @@ typedef union UTString {
 } UTString;
 
 
+/*
+** Body of a rope (follows its 'UTString' header). A rope is a long
+** string built by concatenation whose contents were not copied yet:
+** it only records its pieces, which are the first 'n' entries in the
+** array part of 'buf'. Ropes built one from another (as in 's = s..x')
+** share the same 'buf', so each concatenation only appends its new
+** pieces. The contents are copied to 'flat' when first needed (see
+** 'luaS_flatten'); after that 'buf' is not used anymore.
+** A substring view (SUBBIT also set) is a rope with a single piece:
+** the 'lnglen' bytes of the flat string 'src' from offset 'n' (see
+** 'luaS_newsub'); it keeps 'src' alive until it is flattened.
+*/
+/*
+** rope的extra除了最低位的"has hash"之外还设置ROPEBIT位。rope的内容不在头部之后，
+** 展开前getstr不可用：需要字节的地方要么先用luaS_flatten展开（有lua_State可用），
+** 要么逐段遍历片段（hash、相等比较等）。
+** 子串视图（string.sub、模式捕获的结果）也用rope表示，只是片段是父串中的一段，
+** 不复制内容；父串本身不会是未展开的视图，所以视图不会嵌套。
+*/
+typedef struct Rope {
+  char *flat;  /* contents, once flattened (NULL before that) */
+  union {
+    struct Table *buf;  /* pieces (all flat) of this rope */
+    struct TString *src;  /* string seen by a substring view */
+  } u;
+  size_t n;  /* number of pieces in 'buf' (offset in 'src' for a view) */
+} Rope;
+
+#define ROPEBIT		2
+#define SUBBIT		4
+
+#define isrope(ts)	((ts)->tt == LUA_TLNGSTR && ((ts)->extra & ROPEBIT))
+#define getrope(ts)	cast(Rope *, cast(char *, (ts)) + sizeof(UTString))
+
+/* a rope whose contents were not copied yet */
+#define islazy(ts)	(isrope(ts) && getrope(ts)->flat == NULL)
+
+/* a rope that is a substring view (see 'luaS_newsub') */
+#define issub(ts)	((ts)->tt == LUA_TLNGSTR && ((ts)->extra & SUBBIT))
+
+
 /*
 ** Get the actual string (array of bytes) from a 'TString'.
 ** (Access to 'extra' ensures that value is really a 'TString'.)
 */
 /*
 ** lua中的string内容是紧跟在string头部之后的，所以这里返回的是内容的起始地址。
-** cast(char *, (ts))是获取字符串对象的起始地址。
+** cast(char *, (ts))是获取字符串对象的起始地址。rope的内容则在其'flat'中。
 */
 #define getstr(ts)  \
-  check_exp(sizeof((ts)->extra), cast(char *, (ts)) + sizeof(UTString))
+  check_exp(sizeof((ts)->extra), \
+    (isrope(ts) ? check_exp(!islazy(ts), getrope(ts)->flat) \
+                : cast(char *, (ts)) + sizeof(UTString)))
 
 
 /* get the actual string (array of bytes) from a Lua value */
@@ -546,6 +590,22 @@ typedef struct LocVar {
 /*
 ** Function Prototypes
 */
+/*
+** 'OP_SELF'的多态方法缓存中的一项：接收者的元表为'mt'时，方法位于'holder'的
+** 散列部分的第'node'个节点。只有'epoch'等于当前的g->mcepoch时才有效，
+** 参考luaH_unwatch
+*/
+typedef struct MethodCache {
+  struct Table *mt;  /* metatable of the receiver */
+  struct Table *holder;  /* table in the '__index' chain holding the method */
+  lu_mem epoch;  /* 'g->mcepoch' when this entry was filled */
+  int node;  /* index of the method's node in 'holder' */
+} MethodCache;
+
+/* number of receiver metatables cached by each 'OP_SELF' */
+#define MCWAYS		4
+
+
 /*
 ** Proto结构体用于存放函数的原型信息
 ** 注意，整个lua代码文件解析完成之后，也是生成这么一个Proto的对象，即整个代码文件也当做是一个函数。
@@ -601,6 +661,19 @@ typedef struct Proto {
   //由于proto的upvalue可能不一样，所以数据放到LClosure
   Upvaldesc *upvalues;  /* upvalue information */
   
+  //每个可以作为RK操作数的常量一个散列槽位提示，记录以这个常量短字符串为key的
+  //GETTABUP/GETTABLE/SETTABUP/SETTABLE指令上次命中的node下标，
+  //参考luaH_getshortstrhint。同一个key的各个访问点共用一个提示。
+  int *slothint;  /* node-slot hints for short-string constant keys */
+  int sizeslothint;  /* size of 'slothint' (and of 'mcgroup') */
+
+  //OP_SELF用到的每个方法名常量在mcache中的组号，没有这样的常量时为NULL
+  lu_byte *mcgroup;  /* method-cache group of each method-name constant */
+
+  //所有方法名常量的方法缓存，每个方法名MCWAYS项
+  MethodCache *mcache;  /* method caches for 'OP_SELF' */
+  int sizemcache;
+
   //只保留最近的一个Lua Closure，正常proto和cl是一一对应的，cache一个就够。只有cl中upvalue地址不一样（即upvalue是closed状态），才可能有一个proto有多个cl
   struct LClosure *cache;  /* last-created closure with this prototype */
   TString  *source;  /* used for debug information */
@@ -703,10 +776,37 @@ typedef union TKey {
 ** 散列桶中存放的节点，包括key节点和value节点，其中value节点是通用数据
 ** 类型TValue，而key类型则为TKey。
 */
+#if defined(LUA_SWISSTABLE)
+/*
+** 开放定址时散列部分的key和value分开存放：Node只有key，其中的'next'用来保存
+** key的散列值，value放在平行的数组'hvals'中。探测时只会读到紧凑的key数组。
+*/
+typedef struct Node {
+  TKey i_key;  /* 'next' keeps the hash of the key */
+} Node;
+#else
 typedef struct Node {
   TValue i_val;
   TKey i_key;
 } Node;
+#endif
+
+
+/*
+** 表的形状（隐藏类）。散列部分只有短字符串key的小表不分配Node数组，而是引用
+** 一个共享的Shape：它按插入顺序记录所有key，第i个key的value放在表自己的
+** 紧凑数组'svals'的第i项。key序列相同的表共享同一个Shape，所有Shape都驻留在
+** 'g->shapes'中，不在'allgc'链表上，由GC在清扫阶段的最后单独清扫。
+*/
+typedef struct Shape {
+  CommonHeader;
+  lu_byte nkeys;  /* number of keys */
+  unsigned int hash;  /* hash of the whole key sequence */
+  struct Shape *hnext;  /* linked list for hash table */
+  TString *keys[1];  /* keys, in slot order */
+} Shape;
+
+#define sizeshape(n)	(offsetof(Shape, keys) + sizeof(TString *) * (n))
 
 
 typedef struct Table {
@@ -722,10 +822,28 @@ typedef struct Table {
   /* 散列表中散列桶数组大小,其中大小做了2的对数。即大小必须符合2的对数 */
   lu_byte lsizenode;  /* log2 of size of 'node' array */
 
+  /* 类型化数组部分的元素类型（LUA_TNUMINT或LUA_TNUMFLT），普通数组部分为0 */
+  lu_byte atype;  /* type of the elements of a typed array part, or 0 */
+
+  /*
+  ** 以nil开始、还没有走到末尾的'luaH_next'遍历个数（到MAXNTRAV后不再变化），
+  ** 插入新key时清零。不为0时GC不在清扫阶段收缩该表（见lgc.c的shrinktable）。
+  */
+  lu_byte ntrav;  /* number of traversals by 'next' that may be running */
+
   /* 数组部分的大小 */
   unsigned int sizearray;  /* size of 'array' array */
 
-  /* 指向数组部分的指针 */
+  /* 上次'#'得到的数组部分的边界，不超过sizearray（见luaH_getn） */
+  unsigned int lenhint;  /* hint for the border in the array part */
+
+  /* 上次'luaH_next'返回的key的遍历下标（即'findindex'的结果），0表示没有 */
+  unsigned int nextpos;  /* traversal index of the key last given by 'next' */
+
+  /*
+  ** 指向数组部分的指针。类型化数组部分（atype不为0）时指向一个TypedArray，
+  ** 此时sizearray为0（见ltable.h）。
+  */
   TValue *array;  /* array part */
 
   /*
@@ -735,8 +853,30 @@ typedef struct Table {
   */
   Node *node;
 
+#if defined(LUA_SWISSTABLE)
+  /* 开放定址时每个槽位的控制字节（见ltable.c），紧跟在Node数组之后 */
+  lu_byte *ctrl;  /* control bytes of the hash part */
+  /* 散列部分的value，第i项对应node[i]中的key */
+  TValue *hvals;  /* values of the hash part */
+  /* 在需要rehash之前还能占用的空槽位数 */
+  unsigned int growthleft;  /* free slots that can still be used */
+#else
   /* 指向该表的散列桶数组的最后一个位置的指针 */
   Node *lastfree;  /* any free position is before this position */
+#endif
+
+  /*
+  ** 增量rehash期间还没有搬完的旧散列部分（见ltable.c），它本身是一个只有
+  ** 散列部分的Table头部。其他时候为NULL。
+  */
+  struct Table *old;  /* old hash part being moved into 'node', or NULL */
+
+  /*
+  ** 形状模式下散列部分的key集合及对应的value数组，此时'node'是dummynode，
+  ** 'svals'的容量是不小于key个数的最小的2的整数次幂。普通模式下两者都是NULL。
+  */
+  Shape *shape;  /* keys of the hash part in shape mode */
+  TValue *svals;  /* values of the hash part in shape mode */
 
   /* 存放该表的元表 */
   struct Table *metatable;
@@ -65,6 +65,22 @@ LUAI_DDEF const char *const luaP_opnames[NUM_OPCODES+1] = {
   "CLOSURE",
   "VARARG",
   "EXTRAARG",
+  "ADDII",
+  "ADDFF",
+  "ADDIK",
+  "SUBII",
+  "SUBFF",
+  "MULII",
+  "MULFF",
+  "EQII",
+  "LTII",
+  "LTFF",
+  "LEII",
+  "LEFF",
+  "GETTABUP_GETTABLE",
+  "GETTABLE_GETTABLE",
+  "GETTABUP_CALL",
+  "MOVE_CALL",
   NULL
 };
 
@@ -120,5 +136,84 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 1, OpArgU, OpArgN, iABx)		/* OP_CLOSURE */
  ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_VARARG */
  ,opmode(0, 0, OpArgU, OpArgU, iAx)		/* OP_EXTRAARG */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_ADDII */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_ADDFF */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_ADDIK */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_SUBII */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_SUBFF */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_MULII */
+ ,opmode(0, 1, OpArgK, OpArgK, iABC)		/* OP_MULFF */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_EQII */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LTII */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LTFF */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LEII */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LEFF */
+ ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUP_GETTABLE */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETTABLE_GETTABLE */
+ ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUP_CALL */
+ ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_MOVE_CALL */
 };
 
+
+LUAI_DDEF const lu_byte luaP_baseop[NUM_OPCODES] = {
+  OP_MOVE, OP_LOADK, OP_LOADKX, OP_LOADBOOL, OP_LOADNIL, OP_GETUPVAL,
+  OP_GETTABUP, OP_GETTABLE, OP_SETTABUP, OP_SETUPVAL, OP_SETTABLE,
+  OP_NEWTABLE, OP_SELF, OP_ADD, OP_SUB, OP_MUL, OP_MOD, OP_POW, OP_DIV,
+  OP_IDIV, OP_BAND, OP_BOR, OP_BXOR, OP_SHL, OP_SHR, OP_UNM, OP_BNOT,
+  OP_NOT, OP_LEN, OP_CONCAT, OP_JMP, OP_EQ, OP_LT, OP_LE, OP_TEST,
+  OP_TESTSET, OP_CALL, OP_TAILCALL, OP_RETURN, OP_FORLOOP, OP_FORPREP,
+  OP_TFORCALL, OP_TFORLOOP, OP_SETLIST, OP_CLOSURE, OP_VARARG, OP_EXTRAARG,
+  OP_ADD,		/* OP_ADDII */
+  OP_ADD,		/* OP_ADDFF */
+  OP_ADD,		/* OP_ADDIK */
+  OP_SUB,		/* OP_SUBII */
+  OP_SUB,		/* OP_SUBFF */
+  OP_MUL,		/* OP_MULII */
+  OP_MUL,		/* OP_MULFF */
+  OP_EQ,		/* OP_EQII */
+  OP_LT,		/* OP_LTII */
+  OP_LT,		/* OP_LTFF */
+  OP_LE,		/* OP_LEII */
+  OP_LE,		/* OP_LEFF */
+  OP_GETTABUP,	/* OP_GETTABUP_GETTABLE */
+  OP_GETTABLE,	/* OP_GETTABLE_GETTABLE */
+  OP_GETTABUP,	/* OP_GETTABUP_CALL */
+  OP_MOVE	/* OP_MOVE_CALL */
+};
+
+
+/*
+** 超级指令表：一对相邻指令（第一条, 第二条）以及融合后的操作码。
+** 只选第一条不会被快速化的指令，否则快速化会覆盖掉融合后的操作码。
+*/
+static const struct {
+  lu_byte first, second, fused;
+} fusions[] = {
+  {OP_GETTABUP, OP_GETTABLE, OP_GETTABUP_GETTABLE},  /* mod.func */
+  {OP_GETTABLE, OP_GETTABLE, OP_GETTABLE_GETTABLE},  /* a.b.c */
+  {OP_GETTABUP, OP_CALL, OP_GETTABUP_CALL},  /* f() */
+  {OP_MOVE, OP_CALL, OP_MOVE_CALL}  /* f(..., x) */
+};
+
+
+/*
+** 把'code'中的常见指令对改写为超级指令（只改写第一条指令的操作码）。
+** 指令对之间不重叠：已经作为第二条指令的不再作为第一条，这样超级指令
+** 后面跟着的永远是它期待的那条指令。跳转目标、行号、savedpc都不受影响。
+*/
+void luaP_fuse (Instruction *code, int n) {
+  int pc;
+  for (pc = 0; pc + 1 < n; pc++) {
+    OpCode o1 = GET_OPCODE(code[pc]);
+    OpCode o2 = GET_OPCODE(code[pc + 1]);
+    size_t f;
+    for (f = 0; f < sizeof(fusions) / sizeof(fusions[0]); f++) {
+      if (fusions[f].first == o1 && fusions[f].second == o2) {
+        SET_OPCODE(code[pc], fusions[f].fused);
+        pc++;  /* skip second instruction of the pair */
+        break;
+      }
+    }
+  }
+}
+
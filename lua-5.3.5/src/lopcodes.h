@@ -262,11 +262,39 @@ OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx])			*/
 //OP_VARARG 指令可以把 ... 参数中的若干个复制到当前栈帧
 OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
 
-OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
+OP_EXTRAARG,/*	Ax	extra (larger) argument for previous opcode	*/
+
+/*
+** 以下是"快速化"(quickened)的指令，编译器从不生成它们。luaV_execute在观察到
+** 操作数类型之后，会把OP_ADD等通用指令原地改写成对应的特化版本；特化版本中
+** 的类型检查失败时再改写回通用指令。参考luaP_baseop。
+*/
+OP_ADDII,/*	A B C	R(A) := RK(B) + RK(C)		(integers)	*/
+OP_ADDFF,/*	A B C	R(A) := RK(B) + RK(C)		(floats)	*/
+OP_ADDIK,/*	A B C	R(A) := R(B) + Kst(C)	(integer constant)	*/
+OP_SUBII,/*	A B C	R(A) := RK(B) - RK(C)		(integers)	*/
+OP_SUBFF,/*	A B C	R(A) := RK(B) - RK(C)		(floats)	*/
+OP_MULII,/*	A B C	R(A) := RK(B) * RK(C)		(integers)	*/
+OP_MULFF,/*	A B C	R(A) := RK(B) * RK(C)		(floats)	*/
+OP_EQII,/*	A B C	if ((RK(B) == RK(C)) ~= A) then pc++ (integers)	*/
+OP_LTII,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++ (integers)	*/
+OP_LTFF,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++ (floats)	*/
+OP_LEII,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++ (integers)	*/
+OP_LEFF,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++ (floats)	*/
+
+/*
+** 以下是"超级指令"(superinstruction)：由luaP_fuse在函数加载后改写常见指令对
+** 的第一条得到。第二条指令保持原样留在代码中，超级指令执行完第一条的语义后，
+** 直接跳到第二条指令的处理代码，省掉一次间接分派。操作数格式同第一条指令。
+*/
+OP_GETTABUP_GETTABLE,/*	A B C	OP_GETTABUP; then OP_GETTABLE		*/
+OP_GETTABLE_GETTABLE,/*	A B C	OP_GETTABLE; then OP_GETTABLE		*/
+OP_GETTABUP_CALL,/*	A B C	OP_GETTABUP; then OP_CALL		*/
+OP_MOVE_CALL/*	A B	OP_MOVE; then OP_CALL			*/
 } OpCode;
 
 
-#define NUM_OPCODES	(cast(int, OP_EXTRAARG) + 1)
+#define NUM_OPCODES	(cast(int, OP_MOVE_CALL) + 1)
 
 
 
@@ -327,6 +355,19 @@ LUAI_DDEC const lu_byte luaP_opmodes[NUM_OPCODES];
 LUAI_DDEC const char *const luaP_opnames[NUM_OPCODES+1];  /* opcode names */
 
 
+/*
+** 每个操作码对应的通用操作码：快速化的指令对应其原始指令，超级指令对应其第一
+** 条指令，其余指令对应自身。
+** 调试信息、luaV_finishOp以及string.dump都只认识通用指令。
+*/
+LUAI_DDEC const lu_byte luaP_baseop[NUM_OPCODES];
+
+/* generic opcode of a (possibly quickened) instruction */
+#define GET_BASEOP(i)	(cast(OpCode, luaP_baseop[GET_OPCODE(i)]))
+
+LUAI_FUNC void luaP_fuse (Instruction *code, int n);
+
+
 /* number of list items to accumulate before a SETLIST instruction */
 #define LFIELDS_PER_FLUSH	50
 
@@ -557,10 +557,12 @@ static void close_func (LexState *ls) {
   leaveblock(fs);
   luaM_reallocvector(L, f->code, f->sizecode, fs->pc, Instruction);
   f->sizecode = fs->pc;
+  luaP_fuse(f->code, f->sizecode);
   luaM_reallocvector(L, f->lineinfo, f->sizelineinfo, fs->pc, int);
   f->sizelineinfo = fs->pc;
   luaM_reallocvector(L, f->k, f->sizek, fs->nk, TValue);
   f->sizek = fs->nk;
+  luaF_initslothints(L, f);
   luaM_reallocvector(L, f->p, f->sizep, fs->np, Proto *);
   f->sizep = fs->np;
   luaM_reallocvector(L, f->locvars, f->sizelocvars, fs->nlocvars, LocVar);
@@ -638,6 +640,7 @@ struct ConsControl {
   expdesc v;  /* last list item read */
   expdesc *t;  /* table descriptor */
   int nh;  /* total number of 'record' elements */
+  int nshape;  /* number of 'record' elements with short-string constant keys */
   int na;  /* total number of array elements */
   int tostore;  /* number of array elements pending to be stored */
 };
@@ -656,6 +659,8 @@ static void recfield (LexState *ls, struct ConsControl *cc) {
   else  /* ls->t.token == '[' */
     yindex(ls, &key);
   cc->nh++;
+  if (key.k == VK && ttisshrstring(&fs->f->k[key.u.info]))
+    cc->nshape++;
   checknext(ls, '=');
   rkkey = luaK_exp2RK(fs, &key);
   expr(ls, &val);
@@ -728,7 +733,7 @@ static void constructor (LexState *ls, expdesc *t) {
   int line = ls->linenumber;
   int pc = luaK_codeABC(fs, OP_NEWTABLE, 0, 0, 0);
   struct ConsControl cc;
-  cc.na = cc.nh = cc.tostore = 0;
+  cc.na = cc.nh = cc.nshape = cc.tostore = 0;
   cc.t = t;
   init_exp(t, VRELOCABLE, pc);
   init_exp(&cc.v, VVOID, 0);  /* no value (yet) */
@@ -743,6 +748,12 @@ static void constructor (LexState *ls, expdesc *t) {
   check_match(ls, '}', '{', line);
   lastlistfield(fs, &cc);
   SETARG_B(fs->f->code[pc], luaO_int2fb(cc.na)); /* set initial array size */
+  /*
+  ** 散列部分的key都是短字符串常量且不多于MAXSHAPEKEYS个时不预分配，让表以
+  ** 形状模式开始；其他key无法放进形状，照常预分配散列部分。
+  */
+  if (cc.nh == cc.nshape && cc.nh <= MAXSHAPEKEYS)
+    cc.nh = 0;  /* table starts as a shape */
   SETARG_C(fs->f->code[pc], luaO_int2fb(cc.nh));  /* set initial table size */
 }
 
@@ -328,9 +328,12 @@ static void close_state (lua_State *L) {
   global_State *g = G(L);
   luaF_close(L, L->stack);  /* close all upvalues for this thread */
   luaC_freeallobjects(L);  /* collect all objects */
+  luaH_freeshapes(L);  /* after all tables that use them */
   if (g->version)  /* closing a fully built state? */
     luai_userstateclose(L);
   luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size);
+  luaM_freearray(L, G(L)->strt.old, G(L)->strt.oldsize);
+  luaH_releaseimages(L);  /* after all objects and strings that use them */
   freestack(L);
   lua_assert(gettotalbytes(g) == sizeof(LG));
   (*g->frealloc)(g->ud, fromstate(L), sizeof(LG), 0);  /* free main block */
@@ -441,12 +444,21 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
 
   /* 生成hash操作所需要的随机种子 */
   g->seed = makeseed(L);
+  g->mcepoch = 0;
   g->gcrunning = 0;  /* no GC while building state */
+  g->gcstopem = 0;
   g->GCestimate = 0;
   g->strt.size = g->strt.nuse = 0;
   g->strt.hash = NULL;
+  g->strt.old = NULL;
+  g->strt.oldsize = g->strt.moved = 0;
+  g->shapes.size = g->shapes.nuse = 0;
+  g->shapes.hash = NULL;
   setnilvalue(&g->l_registry);
   g->panic = NULL;
+  g->nextf = g->inextf = NULL;
+  g->frozen = NULL;
+  g->nfrozen = g->sizefrozen = 0;
   g->version = NULL;
   g->gcstate = GCSpause;
   g->gckind = KGC_NORMAL;
@@ -89,9 +89,26 @@ typedef struct stringtable {
   TString **hash;
   int nuse;  /* number of elements */ /* 字符串的数量 */
   int size;  /* hash桶的个数 */
+  /*
+  ** 渐进式调整大小期间，尚未搬到'hash'的旧桶。旧桶中下标小于'moved'的
+  ** 已经搬空；新字符串总是放入'hash'。
+  */
+  TString **old;  /* buckets being moved to 'hash' (NULL if none) */
+  int oldsize;  /* number of buckets in 'old' */
+  int moved;  /* buckets of 'old' already moved */
 } stringtable;
 
 
+/*
+** 驻留所有表形状（Shape）的散列表，按整个key序列散列，参考ltable.c
+*/
+typedef struct shapetable {
+  Shape **hash;
+  int nuse;  /* number of elements */
+  int size;
+} shapetable;
+
+
 /*
 ** Information about a call.
 ** When a thread yields, 'func' is adjusted to pretend that the
@@ -218,6 +235,9 @@ typedef struct global_State {
   ** 长字符串时独立存放的，因此相同的长字符串可能会有多份。
   */
   stringtable strt;  /* hash table for strings */
+
+  /* 所有表形状，key序列相同的表共享同一个Shape */
+  shapetable shapes;  /* hash table for table shapes */
   
   //LUA_REGISTRYINDEX对于的table。其中l_registry下标为2（LUA_RIDX_GLOBALS）是全局表,下标为1（LUA_RIDX_MAINTHREAD）是mainthread；
   //hash部分还会存储其他，如
@@ -225,12 +245,16 @@ typedef struct global_State {
 
   /* lua中进行hash操作时的随机种子，例如给字符串对象进行hash时，会使用该成员的值。 */
   unsigned int seed;  /* randomized seed for hashes */
+
+  //方法缓存（MethodCache）的版本号，被监视的表有变化时递增，参考luaH_unwatch
+  lu_mem mcepoch;  /* current epoch of all method caches */
   //1、lua_newstate 设置为 WHILE0(为1)。2、在atomic原子Mark阶段 转换otherwhile。3、close_state，设置为两种白(为3)
   lu_byte currentwhite;
   lu_byte gcstate;  /* state of garbage collector */
   lu_byte gckind;  /* kind of GC running */
   /* 开启GC的标志位 */
   lu_byte gcrunning;  /* true if GC is running */
+  lu_byte gcstopem;  /* stops emergency collections */
   // 单向链表，所有新建的gc对象，直接放在链表的头部。 参考luaC_newobj
   GCObject *allgc;  /* list of all collectable objects */
   
@@ -293,6 +317,10 @@ typedef struct global_State {
   // panic函数通常是输出一些关键日志
   lua_CFunction panic;  /* to be called in unprotected errors */
 
+  /* 'next'和'ipairs'的迭代函数：OP_TFORCALL遇到它们时直接遍历表，不调用 */
+  lua_CFunction nextf;  /* primitive 'next' (see 'lua_setiterators') */
+  lua_CFunction inextf;  /* primitive 'ipairs' iterator */
+
   /* 主线程Mainthread对应的状态信息 */
   struct lua_State *mainthread;
   /* 存放版本号 */
@@ -308,6 +336,11 @@ typedef struct global_State {
   //对已经保存在c层且需要频繁转换为TString的c层字符串非常有效率上的帮助。strcache内的字符串缓存保存一个gc周期，gc进入sweep阶段前清空
   //STRCACHE_N个桶，每个桶有STRCACHE_M
   TString *strcache[STRCACHE_N][STRCACHE_M];  /* cache for strings in API */
+
+  /* 本状态持有引用的冻结表映像（自己冻结的和从别的状态引入的，见ltable.c） */
+  struct lua_Frozen **frozen;  /* frozen table images used by this state */
+  int nfrozen;  /* number of elements in 'frozen' */
+  int sizefrozen;  /* size of 'frozen' */
 } global_State;
 
 
@@ -463,6 +496,7 @@ union GCUnion {
   struct Table h;
   struct Proto p;
   struct lua_State th;  /* thread */
+  struct Shape sh;
 };
 
 /* 将value对象o进行强制类型转换，转换成union GCUnion* 类型 */
@@ -481,6 +515,7 @@ union GCUnion {
 #define gco2t(o)  check_exp((o)->tt == LUA_TTABLE, &((cast_u(o))->h))
 #define gco2p(o)  check_exp((o)->tt == LUA_TPROTO, &((cast_u(o))->p))
 #define gco2th(o)  check_exp((o)->tt == LUA_TTHREAD, &((cast_u(o))->th))
+#define gco2sh(o)  check_exp((o)->tt == LUA_TSHAPE, &((cast_u(o))->sh))
 
 
 /* macro to convert a Lua object into a GCObject */
@@ -490,7 +525,8 @@ union GCUnion {
 ** 程序可以通过上下文得知。
 */
 #define obj2gco(v) \
-	check_exp(novariant((v)->tt) < LUA_TDEADKEY, (&(cast_u(v)->gc)))
+	check_exp(novariant((v)->tt) < LUA_TDEADKEY || (v)->tt == LUA_TSHAPE, \
+	          (&(cast_u(v)->gc)))
 
 
 /* actual number of total bytes allocated */
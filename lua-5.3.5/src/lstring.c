@@ -16,47 +16,178 @@
 
 #include "ldebug.h"
 #include "ldo.h"
+#include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
 #include "lstring.h"
+#include "ltable.h"
 
 
 #define MEMERRMSG       "not enough memory"
 
 
 /*
-** Lua will use at most ~(2^LUAI_HASHLIMIT) bytes from a string to
-** compute its hash
+** number of buckets of the string table moved to their new place with
+** each new string while the table is being resized (see 'luaS_resize').
+** As a table shrinks only when less than a quarter of it is in use, a
+** resize finishes before the next one would start.
 */
-#if !defined(LUAI_HASHLIMIT)
-#define LUAI_HASHLIMIT		5
-#endif
+#define STRTMOVE	8
+
+
+/*
+** Get the next segment of the contents of string 'ts': a flat string
+** has a single segment; a rope not flattened yet has one segment for
+** each of its pieces (a substring view has one, inside its 'src'). '*i'
+** is the iteration state (start with 0). Segments of a view are not
+** followed by a '\0'.
+*/
+static const char *nextseg (TString *ts, unsigned int *i, size_t *l) {
+  if (!islazy(ts)) {
+    if ((*i)++ > 0) return NULL;
+    *l = tsslen(ts);
+    return getstr(ts);
+  }
+  else if (issub(ts)) {
+    if ((*i)++ > 0) return NULL;
+    *l = ts->u.lnglen;
+    return getstr(getrope(ts)->u.src) + getrope(ts)->n;
+  }
+  else {
+    Rope *r = getrope(ts);
+    TString *p;
+    if (*i >= r->n) return NULL;
+    p = tsvalue(&r->u.buf->array[*i]);
+    (*i)++;
+    *l = tsslen(p);
+    return getstr(p);
+  }
+}
+
+
+/* equality of contents of two strings with the same length */
+static int eqsegs (TString *a, TString *b) {
+  unsigned int ia = 0, ib = 0;
+  const char *sa = NULL, *sb = NULL;
+  size_t la = 0, lb = 0;
+  for (;;) {
+    size_t m;
+    while (la == 0)
+      if ((sa = nextseg(a, &ia, &la)) == NULL) return 1;
+    while (lb == 0)
+      sb = nextseg(b, &ib, &lb);  /* 'b' has as many bytes left as 'a' */
+    m = (la < lb) ? la : lb;
+    if (memcmp(sa, sb, m) != 0) return 0;
+    sa += m; la -= m;
+    sb += m; lb -= m;
+  }
+}
 
 
 /*
 ** equality for long strings
 */
-//长字符串比较，长度和内存比较
+//长字符串比较，长度和内存比较。未展开的rope逐段比较，不需要分配内存
 int luaS_eqlngstr (TString *a, TString *b) {
   size_t len = a->u.lnglen;
   lua_assert(a->tt == LUA_TLNGSTR && b->tt == LUA_TLNGSTR);
   return (a == b) ||  /* same instance or... */
     ((len == b->u.lnglen) &&  /* equal length and ... */
-     (memcmp(getstr(a), getstr(b), len) == 0));  /* equal contents */
+     ((islazy(a) || islazy(b)) ? eqsegs(a, b) :
+       (memcmp(getstr(a), getstr(b), len) == 0)));  /* equal contents */
 }
 
-/* 计算字符串对应的hash值 */
+/*
+** 字符串的hash：所有字节都参与运算，每次处理8个字节（两个32位的字，分别进入
+** 两条互不依赖的累加链，便于流水线并行），不足8个字节的尾部逐字处理，最后
+** 再做一次雪崩混合。不做采样，所以前后缀相同、只在中间几个字节上不同的长key
+** （URL、ID等）也不会冲突。乘数取自xxHash32。
+*/
+
+#define PRIME1		0x9E3779B1u
+#define PRIME2		0x85EBCA77u
+#define PRIME3		0xC2B2AE3Du
+#define PRIME4		0x27D4EB2Fu
+#define PRIME5		0x165667B1u
+
+#define rotl32(x,n)	(((x) << (n)) | ((x) >> (32 - (n))))
 
-//小于32字节的每个字符都会参与hash运算，大于等于32字节的短字符串和
-//长字符串，则会至少跳过一个字节的方式进行hash运算，其计算方式也很简单(l >> 5) + 1。为了加快内部化的过程，计算长字符串哈希值是跳跃进行的
+/* bytes consumed by each step of 'hashblocks' */
+#define HASHBLOCK	8
+
+/* little-endian word at 'p' (compilers turn this into a single load) */
+#define word32(p) \
+  (cast(l_uint32, cast_byte((p)[0])) | cast(l_uint32, cast_byte((p)[1])) << 8 | \
+   cast(l_uint32, cast_byte((p)[2])) << 16 | cast(l_uint32, cast_byte((p)[3])) << 24)
+
+#define hashinit(h,seed)  \
+  ((h)[0] = cast(l_uint32, seed) + PRIME1, (h)[1] = cast(l_uint32, seed) ^ PRIME2)
+
+
+/* hash the whole blocks of 'p' (a partial last block is left out) */
+static void hashblocks (l_uint32 *h, const char *p, size_t l) {
+  l_uint32 a = h[0], b = h[1];
+  for (; l >= HASHBLOCK; l -= HASHBLOCK, p += HASHBLOCK) {
+    a = rotl32(a + word32(p) * PRIME2, 13) * PRIME1;
+    b = rotl32(b + word32(p + 4) * PRIME2, 13) * PRIME1;
+  }
+  h[0] = a; h[1] = b;
+}
+
+
+/* hash the last 'n' (< HASHBLOCK) bytes of a string of length 'l' */
+static unsigned int hashfinal (const l_uint32 *h, const char *p, size_t n,
+                               size_t l) {
+  l_uint32 x = rotl32(h[0], 1) + rotl32(h[1], 7) + cast(l_uint32, l);
+  if (n >= 4) {
+    x = rotl32(x + word32(p) * PRIME3, 17) * PRIME4;
+    p += 4; n -= 4;
+  }
+  for (; n > 0; n--, p++)
+    x = rotl32(x + cast_byte(*p) * PRIME5, 11) * PRIME1;
+  x ^= x >> 15; x *= PRIME2;
+  x ^= x >> 13; x *= PRIME3;
+  x ^= x >> 16;
+  return cast(unsigned int, x);
+}
+
+
+/* 计算字符串对应的hash值 */
 unsigned int luaS_hash (const char *str, size_t l, unsigned int seed) {
-  unsigned int h = seed ^ cast(unsigned int, l);
-  size_t step = (l >> LUAI_HASHLIMIT) + 1;/* if string is too long , don ' t hash all its chars */
-  //固定频率。字符串越长，步长越长
-  for (; l >= step; l -= step)
-    h ^= ((h<<5) + (h>>2) + cast_byte(str[l - 1]));
-  return h;
+  l_uint32 h[2];
+  size_t n = l % HASHBLOCK;
+  hashinit(h, seed);
+  hashblocks(h, str, l - n);
+  return hashfinal(h, str + (l - n), n, l);
+}
+
+
+/*
+** 'luaS_hash' for a rope not flattened yet: its pieces are hashed in
+** order; a block that straddles two pieces is assembled in 'buff'.
+*/
+static unsigned int hashrope (TString *ts, unsigned int seed) {
+  l_uint32 h[2];
+  char buff[HASHBLOCK];
+  size_t nb = 0;  /* number of bytes in 'buff' */
+  unsigned int i = 0;
+  const char *s;
+  size_t l;
+  hashinit(h, seed);
+  while ((s = nextseg(ts, &i, &l)) != NULL) {
+    if (nb > 0) {  /* complete pending block */
+      size_t m = (HASHBLOCK - nb < l) ? HASHBLOCK - nb : l;
+      memcpy(buff + nb, s, m);
+      nb += m; s += m; l -= m;
+      if (nb < HASHBLOCK) continue;  /* piece was too short */
+      hashblocks(h, buff, HASHBLOCK);
+    }
+    hashblocks(h, s, l);
+    nb = l % HASHBLOCK;  /* keep the partial last block */
+    memcpy(buff, s + (l - nb), nb);
+  }
+  return hashfinal(h, buff, nb, ts->u.lnglen);
 }
 
 
@@ -64,9 +195,10 @@ unsigned int luaS_hash (const char *str, size_t l, unsigned int seed) {
 //直到需要对字符串做键匹配时，才惰性计算hash值，加快以后的键比较过程
 unsigned int luaS_hashlongstr (TString *ts) {
   lua_assert(ts->tt == LUA_TLNGSTR);
-  if (ts->extra == 0) {  /* no hash? */
-    ts->hash = luaS_hash(getstr(ts), ts->u.lnglen, ts->hash);
-    ts->extra = 1;  /* now it has its hash */
+  if (!(ts->extra & 1)) {  /* no hash? */
+    ts->hash = islazy(ts) ? hashrope(ts, ts->hash)
+                          : luaS_hash(getstr(ts), ts->u.lnglen, ts->hash);
+    ts->extra |= 1;  /* now it has its hash */
   }
   return ts->hash;
 }
@@ -76,7 +208,7 @@ unsigned int luaS_hashlongstr (TString *ts) {
 ** resizes the string table
 */
 /* 对存放string的hash表进行重hash */
-void luaS_resize (lua_State *L, int newsize) {
+static void resizeall (lua_State *L, int newsize) {
   int i;
 
   /* 获取存放系统中所有string的全局散列表 */
@@ -135,6 +267,62 @@ void luaS_resize (lua_State *L, int newsize) {
 }
 
 
+/*
+** 把旧桶中接下来的（至多）'n'个桶里的字符串搬到新桶，全部搬完后释放旧桶
+*/
+void luaS_movestrings (lua_State *L, int n) {
+  stringtable *tb = &G(L)->strt;
+  int i = tb->moved;
+  int lim = (n < tb->oldsize - i) ? i + n : tb->oldsize;
+  lua_assert(tb->old != NULL);
+  for (; i < lim; i++) {
+    TString *p = tb->old[i];
+    tb->old[i] = NULL;
+    while (p) {  /* for each node in the list */
+      TString *hnext = p->u.hnext;  /* save next */
+      unsigned int h = lmod(p->hash, tb->size);  /* new position */
+      p->u.hnext = tb->hash[h];  /* chain it */
+      tb->hash[h] = p;
+      p = hnext;
+    }
+  }
+  if (i < tb->oldsize)
+    tb->moved = i;
+  else {  /* all moved */
+    luaM_freearray(L, tb->old, tb->oldsize);
+    tb->old = NULL;
+    tb->oldsize = tb->moved = 0;
+  }
+}
+
+
+/*
+** Resizes the string table. A big table (see LUAI_MINSTRTMOVE) only
+** gets its new buckets here; its strings move to them later, a few
+** buckets at a time, as new strings are created and as the collector
+** runs (see 'luaS_movestrings'). Meanwhile, a string may be in either
+** set of buckets.
+*/
+void luaS_resize (lua_State *L, int newsize) {
+  stringtable *tb = &G(L)->strt;
+  if (tb->old != NULL)  /* previous resize not done yet? */
+    luaS_movestrings(L, tb->oldsize);  /* finish it */
+  if (newsize < LUAI_MINSTRTMOVE && tb->size < LUAI_MINSTRTMOVE)
+    resizeall(L, newsize);
+  else {
+    TString **hash = luaM_newvector(L, newsize, TString *);
+    int i;
+    for (i = 0; i < newsize; i++)
+      hash[i] = NULL;
+    tb->old = tb->hash;
+    tb->oldsize = tb->size;
+    tb->moved = 0;
+    tb->hash = hash;
+    tb->size = newsize;
+  }
+}
+
+
 /*
 ** Clear API string cache. (Entries cannot be empty, so fill them with
 ** a non-collectable string.)
@@ -211,6 +399,193 @@ TString *luaS_createlngstrobj (lua_State *L, size_t l) {
   return ts;
 }
 
+
+/*
+** {======================================================
+** Ropes
+** =======================================================
+*/
+
+/* copy the contents of 'ts' to 'buff' */
+static void copysegs (TString *ts, char *buff) {
+  unsigned int i = 0;
+  size_t l;
+  const char *s;
+  while ((s = nextseg(ts, &i, &l)) != NULL) {
+    memcpy(buff, s, l * sizeof(char));
+    buff += l;
+  }
+}
+
+
+/*
+** Copy the contents of a rope to its own buffer. The pieces are not
+** needed after that (other ropes may still be using 'buf').
+*/
+/* 展开后rope的内容在'flat'中，getstr可用；rope节点本身不变，所有引用它的地方都能看到 */
+void luaS_flatten (lua_State *L, TString *ts) {
+  Rope *r = getrope(ts);
+  size_t l = ts->u.lnglen;
+  char *buff;
+  lua_assert(islazy(ts));
+  buff = luaM_newvector(L, l + 1, char);
+  copysegs(ts, buff);
+  buff[l] = '\0';  /* ending 0 */
+  r->flat = buff;
+  r->u.buf = NULL;  /* (also releases the 'src' of a view) */
+}
+
+
+/*
+** Add the pieces of 'ts' at position 'k' of the array part of 'buf'
+** (which must be large enough); returns the position after them.
+*/
+static unsigned int addpieces (lua_State *L, Table *buf, unsigned int k,
+                               TString *ts) {
+  if (!islazy(ts)) {
+    setsvalue(L, &buf->array[k], ts);
+    k++;
+  }
+  else {
+    Rope *r = getrope(ts);
+    unsigned int i;
+    for (i = 0; i < r->n; i++, k++)
+      setobj(L, &buf->array[k], &r->u.buf->array[i]);
+  }
+  return k;
+}
+
+
+/*
+** Creates a rope with length 'l' for the concatenation of the 'n'
+** strings starting at 'first' (which must be the stack top minus 'n').
+** When the first string is a rope whose pieces are the last ones in its
+** 'buf' (the common case 's = s .. x'), the new rope shares that 'buf'
+** and only appends the other strings; otherwise it gets a new 'buf'.
+*/
+/*
+** 除第一个之外的字符串都作为单个片段加入（未展开的rope先展开），因此这里的开销只和
+** 本次拼接的字符串个数有关，与已经累积的长度无关。
+*/
+TString *luaS_newrope (lua_State *L, StkId first, int n, size_t l) {
+  TString *s0 = tsvalue(first);
+  TString *ts;
+  GCObject *o;
+  Table *buf = NULL;
+  unsigned int k, need;
+  int i;
+  for (i = 1; i < n; i++)  /* other pieces must be flat */
+    luaS_flatvalue(L, first + i);
+  if (issub(s0))  /* a view cannot share its pieces */
+    luaS_flat(L, s0);
+  if (islazy(s0)) {
+    Rope *r = getrope(s0);
+    if (r->n == r->u.buf->sizearray || ttisnil(&r->u.buf->array[r->n]))
+      buf = r->u.buf;  /* nobody appended to it: share it */
+    need = cast(unsigned int, r->n) + (n - 1);
+  }
+  else
+    need = n;
+  if (need > cast(unsigned int, MAX_INT) / 2) {  /* too many pieces? */
+    size_t tl = 0;
+    ts = luaS_createlngstrobj(L, l);  /* copy contents as usual */
+    for (i = 0; i < n; i++) {
+      copysegs(tsvalue(first + i), getstr(ts) + tl);
+      tl += tsslen(tsvalue(first + i));
+    }
+    return ts;
+  }
+  if (buf != NULL)
+    k = cast(unsigned int, getrope(s0)->n);
+  else {
+    buf = luaH_new(L);
+    sethvalue2s(L, L->top, buf);  /* anchor it (there is always EXTRA_STACK) */
+    L->top++;
+    k = 0;
+  }
+  if (need > buf->sizearray)  /* grow geometrically */
+    luaH_resizearray(L, buf, (need < 2 * buf->sizearray) ? 2 * buf->sizearray
+                                                          : need);
+  if (k == 0)  /* new 'buf'? */
+    k = addpieces(L, buf, k, s0);
+  for (i = 1; i < n; i++)
+    k = addpieces(L, buf, k, tsvalue(first + i));
+  lua_assert(k == need);
+  if (isblack(buf))  /* 'buf' may be an old table getting new pieces */
+    luaC_barrierback_(L, buf);
+  o = luaC_newobj(L, LUA_TLNGSTR, sizerope);
+  ts = gco2ts(o);
+  ts->extra = ROPEBIT;  /* no hash yet */
+  ts->hash = G(L)->seed;
+  ts->u.lnglen = l;
+  getrope(ts)->flat = NULL;
+  getrope(ts)->u.buf = buf;
+  getrope(ts)->n = need;
+  if (L->top > first + n)  /* remove anchor */
+    L->top--;
+  return ts;
+}
+
+
+/*
+** Creates a string with the 'l' bytes of 's' starting at offset 'off'.
+** Unless it is short, the result is a view into 's' (or into the string
+** seen by 's', when 's' is itself a view) and nothing is copied: the
+** view keeps its source alive until it gets flattened.
+*/
+/*
+** 视图只有在需要'\0'结尾的内容（getstr）或作为表的键时才展开；
+** 比LUAI_MINVIEW短的子串直接复制，避免为一小段内容留住整个父串。
+*/
+TString *luaS_newsub (lua_State *L, TString *s, size_t off, size_t l) {
+  TString *ts;
+  GCObject *o;
+  lua_assert(off + l <= tsslen(s));
+  if (off == 0 && l == tsslen(s))
+    return s;  /* the whole string */
+  if (issub(s) && islazy(s)) {  /* view of a view? */
+    off += getrope(s)->n;
+    s = getrope(s)->u.src;  /* see its source instead */
+  }
+  else
+    luaS_flat(L, s);
+  if (l < LUAI_MINVIEW)  /* short enough to copy? */
+    return luaS_newlstr(L, getstr(s) + off, l);
+  o = luaC_newobj(L, LUA_TLNGSTR, sizerope);
+  ts = gco2ts(o);
+  ts->extra = ROPEBIT | SUBBIT;  /* no hash yet */
+  ts->hash = G(L)->seed;
+  ts->u.lnglen = l;
+  getrope(ts)->flat = NULL;
+  getrope(ts)->u.src = s;
+  getrope(ts)->n = off;
+  return ts;
+}
+
+
+/*
+** 'strchr' over the contents of a rope not flattened yet (used by the
+** collector, which cannot flatten it)
+*/
+const char *luaS_ropechr (TString *ts, int c) {
+  unsigned int i = 0;
+  size_t l;
+  const char *s;
+  while ((s = nextseg(ts, &i, &l)) != NULL) {
+    /* segments of a view do not end with '\0': search only inside them */
+    const char *z = cast(const char *, memchr(s, '\0', l));
+    const char *p = cast(const char *, memchr(s, c, z ? cast(size_t, z - s)
+                                                      : l));
+    if (p != NULL)
+      return p;
+    else if (z != NULL)  /* stopped at a '\0' inside the string? */
+      return NULL;
+  }
+  return NULL;
+}
+
+/* }====================================================== */
+
 /*
 ** 取出存放系统中所有字符串的全局hash表，并根据待删除的字符串中的hash值
 ** 找到相应的hash桶，然后遍历桶中的所有字符串，找到待删除的字符串，将其中
@@ -220,8 +595,14 @@ TString *luaS_createlngstrobj (lua_State *L, size_t l) {
 void luaS_remove (lua_State *L, TString *ts) {
   stringtable *tb = &G(L)->strt;
   TString **p = &tb->hash[lmod(ts->hash, tb->size)];
-  while (*p != ts)  /* find previous element */
+  while (*p != ts && *p != NULL)  /* find previous element */
     p = &(*p)->u.hnext;
+  if (*p == NULL) {  /* not moved yet? */
+    lua_assert(tb->old != NULL);
+    p = &tb->old[lmod(ts->hash, tb->oldsize)];
+    while (*p != ts)  /* find previous element */
+      p = &(*p)->u.hnext;
+  }
   *p = (*p)->u.hnext;  /* remove element from its list */
   tb->nuse--;
 }
@@ -234,32 +615,74 @@ void luaS_remove (lua_State *L, TString *ts) {
 ** 短字符串对象的创建，并且创建之后会立即加入到全局状态信息（global_State）的strt成员中。
 ** strt成员是一个hash表，专门用来存放Lua中的全部短字符串对象。长字符串对象则不会放置在这里。
 */
-static TString *internshrstr (lua_State *L, const char *str, size_t l) {
-  TString *ts;
+/*
+** Looks for a short string in the frozen table images used by the state
+** (see 'luaS_adopt'). Their strings are not in 'strt', but they are the
+** strings of the state with their contents all the same.
+*/
+static TString *frozenstr (global_State *g, const char *str, size_t l,
+                           unsigned int h) {
+  int i;
+  for (i = 0; i < g->nfrozen; i++) {
+    const lua_Frozen *f = g->frozen[i];
+    unsigned int mask = cast(unsigned int, f->sizestrs - 1);
+    unsigned int j;
+    if (f->sizestrs == 0) continue;
+    for (j = h & mask; f->strs[j] != NULL; j = (j + 1) & mask) {
+      TString *ts = f->strs[j];
+      if (ts->hash == h && l == ts->shrlen &&
+          memcmp(str, getstr(ts), l * sizeof(char)) == 0)
+        return ts;
+    }
+  }
+  return NULL;
+}
 
-  global_State *g = G(L);  /* 获取全局状态信息 */
-  unsigned int h = luaS_hash(str, l, g->seed);  /* 计算字符串对应的hash值 */
-  TString **list = &g->strt.hash[lmod(h, g->strt.size)];  /* 找到对应的hash桶 */
-  lua_assert(str != NULL);  /* otherwise 'memcmp'/'memcpy' are undefined */
 
+/* looks for short string 'str' in list 'ts' of 'strt' */
+static TString *findinlist (TString *ts, const char *str, size_t l) {
   //可能存在hash冲突
-  for (ts = *list; ts != NULL; ts = ts->u.hnext) {
+  for (; ts != NULL; ts = ts->u.hnext) {
     //创建过程是需要比长度和内存对比，由于短字符串有且只有一份，后续比较只需要比较TString地址即可
     if (l == ts->shrlen &&
-        (memcmp(str, getstr(ts), l * sizeof(char)) == 0)) {
-      /* found! */
-      if (isdead(g, ts))  /* dead (but not collected yet)? */
-        changewhite(ts);  /* resurrect it */
-      return ts;
-    }
+        (memcmp(str, getstr(ts), l * sizeof(char)) == 0))
+      return ts;  /* found! */
   }
+  return NULL;
+}
 
 
+/* looks for short string 'str' (with hash 'h') in the string table */
+static TString *findshrstr (stringtable *tb, const char *str, size_t l,
+                            unsigned int h) {
+  TString *ts = findinlist(tb->hash[lmod(h, tb->size)], str, l);
+  if (ts == NULL && tb->old != NULL)  /* not found in the new buckets? */
+    ts = findinlist(tb->old[lmod(h, tb->oldsize)], str, l);
+  return ts;
+}
+
+
+static TString *internshrstr (lua_State *L, const char *str, size_t l) {
+  TString *ts;
+  TString **list;
+  global_State *g = G(L);  /* 获取全局状态信息 */
+  unsigned int h = luaS_hash(str, l, g->seed);  /* 计算字符串对应的hash值 */
+  lua_assert(str != NULL);  /* otherwise 'memcmp'/'memcpy' are undefined */
+  ts = findshrstr(&g->strt, str, l, h);
+  if (ts != NULL) {  /* found! */
+    if (isdead(g, ts))  /* dead (but not collected yet)? */
+      changewhite(ts);  /* resurrect it */
+    return ts;
+  }
+  if (g->nfrozen > 0 && (ts = frozenstr(g, str, l, h)) != NULL)
+    return ts;
+
   //数量大于hash桶数，扩张
-  if (g->strt.nuse >= g->strt.size && g->strt.size <= MAX_INT/2) {
+  if (g->strt.nuse >= g->strt.size && g->strt.size <= MAX_INT/2)
     luaS_resize(L, g->strt.size * 2);
-    list = &g->strt.hash[lmod(h, g->strt.size)];  /* recompute with new size */
-  }
+  else if (g->strt.old != NULL)  /* resizing? */
+    luaS_movestrings(L, STRTMOVE);  /* each new string moves a few buckets */
+  list = &g->strt.hash[lmod(h, g->strt.size)];  /* 找到对应的hash桶 */
 
   /* 创建一个新的字符串对象，并填入字符串内容，字符串的内容紧跟在字符串头部后面 */
   ts = createstrobj(L, l, LUA_TSHRSTR, h);
@@ -359,3 +782,143 @@ Udata *luaS_newudata (lua_State *L, size_t s) {
   return u;
 }
 
+
+/*
+** {======================================================
+** Strings of frozen table images
+** =======================================================
+*/
+
+/* true if the only strings of the state are the fixed ones */
+static int onlyfixed (global_State *g) {
+  GCObject *o;
+  if (g->nfrozen > 0 || g->shapes.nuse > 0)
+    return 0;
+  for (o = g->allgc; o != NULL; o = o->next) {
+    if (o->tt == LUA_TSHRSTR || o->tt == LUA_TLNGSTR)
+      return 0;
+  }
+  return 1;
+}
+
+
+/*
+** 'ts', already out of 'strt', is to be replaced by 'fts', an equal
+** string of a frozen table image (see 'luaC_replacestrings')
+*/
+static void replacewith (TString *ts, TString *fts) {
+  lua_assert(!isblack(ts) && ts->hash == fts->hash);
+  ts->u.hnext = fts;
+  gray2black(ts);
+}
+
+
+/*
+** A state that has only its fixed strings (reserved words, metamethod
+** names and the like) takes the hash seed of image 'f': all its strings
+** are hashed again, and the ones also in 'f' are to be replaced by
+** those. Returns the number of them.
+*/
+static int reseed (lua_State *L, const lua_Frozen *f) {
+  global_State *g = G(L);
+  stringtable *tb = &g->strt;
+  int i, n = 0;
+  g->seed = f->seed;
+  if (tb->old != NULL)  /* being resized? */
+    luaS_movestrings(L, tb->oldsize);  /* all strings in 'hash' */
+  for (i = 0; i < tb->size; i++) {
+    TString **p = &tb->hash[i];
+    while (*p != NULL) {
+      TString *ts = *p;
+      TString *fts;
+      ts->hash = luaS_hash(getstr(ts), ts->shrlen, g->seed);
+      fts = frozenstr(g, getstr(ts), ts->shrlen, ts->hash);
+      if (fts == NULL)
+        p = &ts->u.hnext;
+      else {
+        *p = ts->u.hnext;  /* remove it from 'strt' */
+        tb->nuse--;
+        replacewith(ts, fts);
+        n++;
+      }
+    }
+  }
+  resizeall(L, tb->size);  /* rehash with the new hashes (all at once) */
+  return n;
+}
+
+
+/*
+** Makes the short strings of image 'f' the strings of the state with
+** their contents, so that short strings still compare by address. A
+** string that the state already has is replaced by the one of 'f' in
+** all objects of the state (see 'luaC_replacestrings'); pointers to its
+** contents and string handles for it that the host got before are no
+** longer valid. The image must use the hash seed of the state (a state
+** that has only its fixed strings, as after 'lua_newstate', takes the
+** seed of the image) and cannot have strings equal to the ones of other
+** images in use. Called just before 'f' goes into 'g->frozen'.
+*/
+void luaS_adopt (lua_State *L, lua_Frozen *f) {
+  global_State *g = G(L);
+  int i, n = 0;
+  luaC_runtilstate(L, bitmask(GCSpause));  /* no black objects */
+  if (onlyfixed(g)) {  /* (even with the same seed, to replace them) */
+    g->frozen[g->nfrozen] = f;  /* visible to 'frozenstr' for a moment */
+    g->nfrozen++;
+    n = reseed(L, f);
+    g->nfrozen--;
+  }
+  else {
+    if (g->seed != f->seed)
+      luaG_runerror(L, "frozen table made with another hash seed");
+    for (i = 0; i < f->sizestrs; i++) {  /* check before any change */
+      TString *ts = f->strs[i];
+      if (ts != NULL && frozenstr(g, getstr(ts), ts->shrlen, ts->hash))
+        luaG_runerror(L, "string '%s' of frozen table already in another one",
+                         getstr(ts));
+    }
+  }
+  for (i = 0; i < f->sizestrs; i++) {
+    TString *ts = f->strs[i];
+    TString *o;
+    if (ts == NULL) continue;
+    o = findshrstr(&g->strt, getstr(ts), ts->shrlen, ts->hash);
+    if (o != NULL) {  /* the state has it: use the one of 'f' instead */
+      luaS_remove(L, o);
+      replacewith(o, ts);
+      n++;
+    }
+  }
+  if (n > 0)
+    luaC_replacestrings(L);
+}
+
+
+/*
+** Pushes a new table with all short strings of the state as its array
+** part; freezing it makes a string pool (see 'lua_poolstrings'). The
+** collector is taken to the end of a cycle first, so that there are no
+** dead strings left in 'strt'.
+*/
+void luaS_pushstrings (lua_State *L) {
+  global_State *g = G(L);
+  stringtable *tb = &g->strt;
+  Table *t;
+  int i, n = 0;
+  luaC_runtilstate(L, bitmask(GCSpause));
+  t = luaH_new(L);
+  sethvalue2s(L, L->top, t);  /* anchor it */
+  luaD_inctop(L);
+  luaH_resize(L, t, cast(unsigned int, tb->nuse), 0);
+  for (i = 0; i < tb->size + tb->oldsize; i++) {
+    TString *ts = (i < tb->size) ? tb->hash[i] : tb->old[i - tb->size];
+    for (; ts != NULL; ts = ts->u.hnext) {
+      lua_assert(!isdead(g, ts) && n < tb->nuse);
+      setsvalue(L, &t->array[n++], ts);
+    }
+  }
+  lua_assert(n == tb->nuse);
+}
+
+/* }====================================================== */
@@ -22,6 +22,9 @@
 /* 获取Userdata对象中内容部分的大小 */
 #define sizeudata(u)	sizeludata((u)->len)
 
+/* 计算一个rope节点需要的内存大小（不含展开后的内容） */
+#define sizerope	(sizeof(union UTString) + sizeof(Rope))
+
 #define luaS_newliteral(L, s)	(luaS_newlstr(L, "" s, \
                                  (sizeof(s)/sizeof(char))-1))
 
@@ -41,10 +44,23 @@
 #define eqshrstr(a,b)	check_exp((a)->tt == LUA_TSHRSTR, (a) == (b))
 
 
+/*
+** make sure the contents of a string are available through 'getstr'
+** (only ropes may need it)
+*/
+#define luaS_flat(L,ts)	(islazy(ts) ? luaS_flatten(L, ts) : (void)0)
+
+#define islazyvalue(o)	(ttislngstring(o) && islazy(tsvalue(o)))
+
+#define luaS_flatvalue(L,o) \
+	(islazyvalue(o) ? luaS_flatten(L, tsvalue(o)) : (void)0)
+
+
 LUAI_FUNC unsigned int luaS_hash (const char *str, size_t l, unsigned int seed);
 LUAI_FUNC unsigned int luaS_hashlongstr (TString *ts);
 LUAI_FUNC int luaS_eqlngstr (TString *a, TString *b);
 LUAI_FUNC void luaS_resize (lua_State *L, int newsize);
+LUAI_FUNC void luaS_movestrings (lua_State *L, int n);
 LUAI_FUNC void luaS_clearcache (global_State *g);
 LUAI_FUNC void luaS_init (lua_State *L);
 LUAI_FUNC void luaS_remove (lua_State *L, TString *ts);
@@ -52,6 +68,13 @@ LUAI_FUNC Udata *luaS_newudata (lua_State *L, size_t s);
 LUAI_FUNC TString *luaS_newlstr (lua_State *L, const char *str, size_t l);
 LUAI_FUNC TString *luaS_new (lua_State *L, const char *str);
 LUAI_FUNC TString *luaS_createlngstrobj (lua_State *L, size_t l);
+LUAI_FUNC TString *luaS_newrope (lua_State *L, StkId first, int n, size_t l);
+LUAI_FUNC void luaS_flatten (lua_State *L, TString *ts);
+LUAI_FUNC TString *luaS_newsub (lua_State *L, TString *s, size_t off,
+                                                         size_t l);
+LUAI_FUNC const char *luaS_ropechr (TString *ts, int c);
+LUAI_FUNC void luaS_adopt (lua_State *L, lua_Frozen *f);
+LUAI_FUNC void luaS_pushstrings (lua_State *L);
 
 
 #endif
@@ -74,7 +74,7 @@ static lua_Integer posrelat (lua_Integer pos, size_t len) {
 
 static int str_sub (lua_State *L) {
   size_t l;
-  const char *s = luaL_checklstring(L, 1, &l);
+  luaL_checklstring(L, 1, &l);
   //传0和传1的效果一样
   lua_Integer start = posrelat(luaL_checkinteger(L, 2), l);
   lua_Integer end = posrelat(luaL_optinteger(L, 3, -1), l);
@@ -82,8 +82,8 @@ static int str_sub (lua_State *L) {
   //下标修正，从1开始。
   if (start < 1) start = 1;
   if (end > (lua_Integer)l) end = l;
-  if (start <= end)
-    lua_pushlstring(L, s + start - 1, (size_t)(end - start) + 1);
+  if (start <= end)  /* (long results are views into 's') */
+    lua_pushsubstring(L, 1, (size_t)start - 1, (size_t)(end - start) + 1);
   else lua_pushliteral(L, "");
   return 1;
 }
@@ -225,6 +225,7 @@ typedef struct MatchState {
   const char *src_end;  /* end ('\0') of source string */
   const char *p_end;  /* end ('\0') of pattern */
   lua_State *L;
+  int srcidx;  /* stack index of source string (for views into it) */
   //默认200，同时需要>0
   int matchdepth;  /* control for recursive depth (to avoid C stack overflow) */
 
@@ -566,7 +567,8 @@ static void push_onecapture (MatchState *ms, int i, const char *s,
                                                     const char *e) {
   if (i >= ms->level) {
     if (i == 0)  /* ms->level == 0, too */
-      lua_pushlstring(ms->L, s, e - s);  /* add whole match */
+      lua_pushsubstring(ms->L, ms->srcidx, s - ms->src_init,
+                        e - s);  /* add whole match */
     else
       luaL_error(ms->L, "invalid capture index %%%d", i + 1);
   }
@@ -576,7 +578,8 @@ static void push_onecapture (MatchState *ms, int i, const char *s,
     if (l == CAP_POSITION)
       lua_pushinteger(ms->L, (ms->capture[i].init - ms->src_init) + 1);
     else
-      lua_pushlstring(ms->L, ms->capture[i].init, l);
+      lua_pushsubstring(ms->L, ms->srcidx,
+                        ms->capture[i].init - ms->src_init, l);
   }
 }
 
@@ -604,9 +607,10 @@ static int nospecials (const char *p, size_t l) {
 }
 
 
-static void prepstate (MatchState *ms, lua_State *L,
+static void prepstate (MatchState *ms, lua_State *L, int srcidx,
                        const char *s, size_t ls, const char *p, size_t lp) {
   ms->L = L;
+  ms->srcidx = srcidx;
   ms->matchdepth = MAXCCALLS;
   ms->src_init = s;
   ms->src_end = s + ls;
@@ -649,7 +653,7 @@ static int str_find_aux (lua_State *L, int find) {
     if (anchor) {
       p++; lp--;  /* skip anchor character */
     }
-    prepstate(&ms, L, s, ls, p, lp);
+    prepstate(&ms, L, 1, s, ls, p, lp);
     do {
       const char *res;
       reprepstate(&ms);
@@ -714,7 +718,8 @@ static int gmatch (lua_State *L) {
   GMatchState *gm;
   lua_settop(L, 2);  /* keep them on closure to avoid being collected */
   gm = (GMatchState *)lua_newuserdata(L, sizeof(GMatchState)); //stack: s | pattern | GMatchState
-  prepstate(&gm->ms, L, s, ls, p, lp);
+  /* 's' is the first upvalue of 'gmatch_aux' */
+  prepstate(&gm->ms, L, lua_upvalueindex(1), s, ls, p, lp);
   gm->src = s; gm->p = p; gm->lastmatch = NULL;
   lua_pushcclosure(L, gmatch_aux, 3);//stack: cclosure(func:gmatch_aux, upvalue:s | pattern | GMatchState)
   return 1;
@@ -798,7 +803,7 @@ static int str_gsub (lua_State *L) {
   if (anchor) {
     p++; lp--;  /* skip anchor character */
   }
-  prepstate(&ms, L, src, srcl, p, lp);
+  prepstate(&ms, L, 1, src, srcl, p, lp);
   while (n < max_s) {
     const char *e;
     reprepstate(&ms);  /* (re)prepare state for new match */
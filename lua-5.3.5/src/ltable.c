@@ -21,10 +21,17 @@
 ** in its main position (i.e. the 'original' position that its hash gives
 ** to it), then the colliding element is in its own main position.
 ** Hence even when the load factor reaches 100%, performance remains good.
+** With LUA_SWISSTABLE the hash part uses open addressing instead (see
+** "Open addressing" below).
 */
 
 #include <math.h>
 #include <limits.h>
+#include <string.h>
+
+#if defined(LUA_SWISSTABLE) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "lua.h"
 
@@ -85,10 +92,70 @@
 
 #define dummynode		(&dummynode_)
 
+#if defined(LUA_SWISSTABLE)
+static const Node dummynode_ = {
+  {{NILCONSTANT, 0}}  /* key (its value is 'luaO_nilobject') */
+};
+#else
 static const Node dummynode_ = {
   {NILCONSTANT},  /* value */
   {{NILCONSTANT, 0}}  /* key */
 };
+#endif
+
+
+/*
+** 增量rehash：较大的散列部分改变大小时，旧的Node数组先保留在't->old'中，
+** 之后每插入一个新key就搬走其中一小段（见'moveold'）。旧散列部分由一个
+** 没有数组部分的Table头部描述，所有查找函数都可以直接用在它上面。一个key
+** 只会在其中一个散列部分里有非nil的value：查找先找新散列部分，找不到再找
+** 旧的；新key总是进入新散列部分。
+*/
+typedef struct OldHash {
+  Table h;  /* the old hash part (must be the first field) */
+  unsigned int moved;  /* nodes of 'h' already moved */
+  unsigned int step;  /* nodes to move for each new key */
+} OldHash;
+
+#define oldhash(t)	cast(OldHash *, (t)->old)
+
+/* minimum number of old nodes moved for each new key */
+#define MOVESTEP	8
+
+
+/* a value in the old hash part: nil there means that the key is absent */
+static const TValue *oldslot (const TValue *v) {
+  return ttisnil(v) ? luaO_nilobject : v;
+}
+
+/* result of lookup 'get' in 't->old', for a key missing from 't' */
+#define getold(t,get)	((t)->old == NULL ? luaO_nilobject : oldslot(get))
+
+
+/*
+** 返回短字符串'key'在形状's'中的槽位，不存在则返回-1。形状最多只有
+** MAXSHAPEKEYS个key，并且key都是驻留的短字符串，顺序比较指针就够了。
+*/
+static int shapeslot (const Shape *s, const TString *key) {
+  int i;
+  for (i = 0; i < s->nkeys; i++) {
+    if (s->keys[i] == key)
+      return i;
+  }
+  return -1;
+}
+
+
+/* number of non-nil values in the shape part of 't' */
+static int shapeuse (const Table *t) {
+  int i;
+  int n = 0;
+  for (i = 0; i < t->shape->nkeys; i++) {
+    if (!ttisnil(&t->svals[i]))
+      n++;
+  }
+  return n;
+}
 
 
 /*
@@ -121,6 +188,189 @@ static int l_hashfloat (lua_Number n) {
 #endif
 
 
+#if defined(LUA_SWISSTABLE)
+/*
+** {=============================================================
+** Open addressing
+** ==============================================================
+*/
+
+/*
+** 开放定址的散列部分：key数组'node'（'next'保存散列值）、平行的value数组
+** 'hvals'，另外每个槽位有一个控制字节，三者依次放在同一块内存中。控制字节CTRLEMPTY表示空槽，否则是key散列值的低7位
+** （标签）。槽位每GROUPSIZE个一组，查找时一次比较一整组控制字节，只有标签
+** 相同的槽位才需要比较key；组内还有空槽就说明key不存在，否则按三角数序列
+** 探测下一组。Lua从不真正删除key（value置为nil的项和deadkey都留在原处，
+** 直到下次rehash），所以空槽不会重新出现，也就不需要墓碑。容量不足一组时
+** 控制字节补齐到一组，补齐的部分始终是空槽。
+*/
+
+#define CTRLEMPTY	0x80
+
+/* hash of the key in node 'n' (the field 'next' is not used for chains) */
+#define nodehash(n)	cast(unsigned int, gnext(n))
+
+#define tagof(h)	cast_byte((h) & 0x7f)
+
+/* number of groups in the hash part of 't' */
+#define numgroups(t)	((sizenode(t) + GROUPSIZE - 1) / GROUPSIZE)
+
+/* mask of the slots that exist in a group of 't' */
+#define slotmask(t)	(sizenode(t) < GROUPSIZE ? twoto(sizenode(t)) - 1u \
+                                             : twoto(GROUPSIZE) - 1u)
+
+/*
+** maximum number of keys in a hash part with 'n' slots: a single group
+** can be full (probing stops after the last group), larger ones keep
+** 1/8 of their slots empty so that misses stop early
+*/
+#define maxload(n)	((n) <= GROUPSIZE ? (n) : (n) - (n) / 8)
+
+
+#if defined(__GNUC__)
+#define lowbit(m)	__builtin_ctz(m)
+#else
+static int lowbit (unsigned int m) {
+  int i = 0;
+  while (!(m & 1u)) { m >>= 1; i++; }
+  return i;
+}
+#endif
+
+
+/*
+** 'matchtag' gives a mask with the slots of group 'c' whose control byte
+** is 'tag'; 'matchempty' gives the empty ones
+*/
+#if defined(__SSE2__)
+
+#define loadgroup(c)	_mm_loadu_si128(cast(const __m128i *, (c)))
+
+#define matchtag(c,tag)  cast(unsigned int, _mm_movemask_epi8( \
+	_mm_cmpeq_epi8(loadgroup(c), _mm_set1_epi8(cast(char, tag)))))
+
+#define matchempty(c)	cast(unsigned int, _mm_movemask_epi8(loadgroup(c)))
+
+#else
+
+static unsigned int matchtag (const lu_byte *c, lu_byte tag) {
+  unsigned int m = 0;
+  int i;
+  for (i = 0; i < GROUPSIZE; i++)
+    m |= cast(unsigned int, c[i] == tag) << i;
+  return m;
+}
+
+#define matchempty(c)	matchtag(c, CTRLEMPTY)
+
+#endif
+
+
+/*
+** Finalizer from MurmurHash3: the tag takes the low bits and the group
+** the bits above them, so all bits of the original hash must count.
+*/
+static unsigned int mixhash (unsigned int h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+
+/* fold an integer into an 'unsigned int' (which may be narrower) */
+static unsigned int inthash (lua_Integer i) {
+  lua_Unsigned u = l_castS2U(i);
+  return mixhash(cast(unsigned int, u) ^ cast(unsigned int, (u >> 16) >> 16));
+}
+
+
+static unsigned int hashkey (const TValue *key) {
+  switch (ttype(key)) {
+    case LUA_TNUMINT:
+      return inthash(ivalue(key));
+    case LUA_TNUMFLT:
+      return mixhash(cast(unsigned int, l_hashfloat(fltvalue(key))));
+    case LUA_TSHRSTR:
+      return mixhash(tsvalue(key)->hash);
+    case LUA_TLNGSTR:
+      return mixhash(luaS_hashlongstr(tsvalue(key)));
+    case LUA_TBOOLEAN:
+      return mixhash(cast(unsigned int, bvalue(key)));
+    case LUA_TLIGHTUSERDATA:
+      return mixhash(point2uint(pvalue(key)));
+    case LUA_TLCF:
+      return mixhash(point2uint(fvalue(key)));
+    default:
+      lua_assert(!ttisdeadkey(key));
+      return mixhash(point2uint(gcvalue(key)));
+  }
+}
+
+
+/*
+** Probe the hash part of 't' for hash 'h': run 'body' (which may
+** 'return') for each node 'n' whose tag matches, until a group with an
+** empty slot (or the last group) has been looked at. The sequence of
+** groups is the triangular one, which visits all of them because their
+** number is a power of 2.
+*/
+#define probe(t,h,n,body) { \
+  unsigned int gm_ = numgroups(t) - 1; \
+  unsigned int g_ = ((h) >> 7) & gm_; \
+  unsigned int i_ = 0; \
+  for (;;) { \
+    const lu_byte *c_ = (t)->ctrl + g_ * GROUPSIZE; \
+    unsigned int m_; \
+    for (m_ = matchtag(c_, tagof(h)); m_ != 0; m_ &= m_ - 1) { \
+      Node *n = gnode(t, g_ * GROUPSIZE + lowbit(m_)); \
+      body \
+    } \
+    if (matchempty(c_) != 0 || i_ == gm_) break; \
+    g_ = (g_ + ++i_) & gm_; \
+  } }
+
+
+/*
+** 为散列值为'h'的新key占用探测序列上的第一个空槽（与查找的探测序列一致），
+** 并记下散列值。调用者保证'growthleft'大于0，因此一定能找到。
+*/
+static Node *getfreepos (Table *t, unsigned int h) {
+  unsigned int gm = numgroups(t) - 1;
+  unsigned int g = (h >> 7) & gm;
+  unsigned int i = 0;
+  lua_assert(t->growthleft > 0);
+  for (;;) {
+    lu_byte *c = t->ctrl + g * GROUPSIZE;
+    unsigned int m = matchempty(c) & slotmask(t);
+    if (m != 0) {
+      int j = lowbit(m);
+      Node *n = gnode(t, g * GROUPSIZE + j);
+      c[j] = tagof(h);
+      t->growthleft--;
+      gnext(n) = cast_int(h);
+      return n;
+    }
+    lua_assert(i < gm);
+    g = (g + ++i) & gm;
+  }
+}
+
+
+LUAI_DDEF const lu_byte luaH_emptyctrl_[GROUPSIZE] = {
+  CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY,
+  CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY,
+  CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY,
+  CTRLEMPTY, CTRLEMPTY, CTRLEMPTY, CTRLEMPTY
+};
+
+/* }============================================================= */
+
+#else
+
+
 /*
 ** returns the 'main' position of an element in a table (that is, the index
 ** of its hash value)
@@ -158,6 +408,12 @@ static Node *mainposition (const Table *t, const TValue *key) {
   }
 }
 
+#endif
+
+
+/* number of keys owned by the array part of 't' (typed or not) */
+#define arraysize(t)	(istyped(t) ? typedarray(t)->size : (t)->sizearray)
+
 
 /*
 ** returns the index for 'key' if 'key' is an appropriate key to live in
@@ -182,6 +438,47 @@ static unsigned int arrayindex (const TValue *key) {
 }
 
 
+/* frozen tables are never written, not even this hint (see 'luaH_freeze') */
+#define setnextpos(t,i)	(isfrozen(t) ? (void)0 : (void)((t)->nextpos = (i)))
+
+
+/*
+** Count of the traversals of a table that may be running: one starts
+** when 'next' gets a nil key and ends when 'next' finds no more
+** elements. A traversal left before its end (a 'break') keeps the
+** count up until the next new key, after which no traversal may go on
+** anyway. Once the count reaches MAXNTRAV it stays there until then.
+*/
+#define MAXNTRAV	255
+
+static void starttrav (Table *t) {
+  if (!isfrozen(t) && t->ntrav < MAXNTRAV)
+    t->ntrav++;
+}
+
+static void endtrav (Table *t) {
+  if (!isfrozen(t) && t->ntrav > 0 && t->ntrav < MAXNTRAV)
+    t->ntrav--;
+}
+
+
+/*
+** true if 'key' is the key at traversal index 't->nextpos', outside the
+** array part: a traversal then finds its place again without looking
+** the key up. The position is checked against the current hash part,
+** so it stays correct across resizes without being reset.
+*/
+static int atnextpos (const Table *t, const TValue *key, unsigned int asize) {
+  unsigned int p = t->nextpos - 1 - asize;  /* position after array part */
+  if (isshaped(t))
+    return (p < cast(unsigned int, t->shape->nkeys) && ttisshrstring(key) &&
+            t->shape->keys[p] == tsvalue(key));
+  else
+    return (p < cast(unsigned int, sizenode(t)) &&
+            luaV_rawequalobj(gkey(gnode(t, p)), key));
+}
+
+
 /*
 ** returns the index of a 'key' for table traversals. First goes all
 ** elements in the array part, then elements in the hash part. The
@@ -194,6 +491,7 @@ static unsigned int arrayindex (const TValue *key) {
 ** 不合法的索引，所以可以通过返回一个0来表示没有找到对应的key对应的索引。
 */
 static unsigned int findindex (lua_State *L, Table *t, StkId key) {
+  unsigned int asize = arraysize(t);
   unsigned int i;
   /* 如果key是一个nil对象，那么就返回0。 */
   if (ttisnil(key)) return 0;  /* first iteration */
@@ -204,9 +502,41 @@ static unsigned int findindex (lua_State *L, Table *t, StkId key) {
   ** 返回的索引超过了数组的大小，那说明这个索引虽然是一个整数，但是会存放在散列表中
   */
   i = arrayindex(key);
-  if (i != 0 && i <= t->sizearray)  /* is 'key' inside array part? */
+  if (i != 0 && i <= asize)  /* is 'key' inside array part? */
     /* 落在了数组部分 */
     return i;  /* yes; that's the index */
+  else if (t->nextpos > asize && atnextpos(t, key, asize))
+    return t->nextpos;  /* key given by the last 'luaH_next' */
+  else if (isshaped(t)) {  /* 形状模式：下标就是key在Shape中的槽位 */
+    int j = ttisshrstring(key) ? shapeslot(t->shape, tsvalue(key)) : -1;
+    if (j < 0)
+      luaG_runerror(L, "invalid key to 'next'");  /* key not found */
+    return (j + 1) + asize;
+  }
+#if defined(LUA_SWISSTABLE)
+  else {
+    unsigned int h = hashkey(key);
+    Node *dead = NULL;
+    probe(t, h, n,
+      if (luaV_rawequalobj(gkey(n), key))
+        return (cast_int(n - gnode(t, 0)) + 1) + asize;
+      /* key may be dead already, but it is ok to use it in 'next' */
+      else if (dead == NULL && ttisdeadkey(gkey(n)) && iscollectable(key) &&
+               deadvalue(gkey(n)) == gcvalue(key))
+        dead = n;
+    )
+    /*
+    ** 死键的地址可能已经被一个新对象重用，而这个对象又作为新key插入到了探测
+    ** 序列的后面；只有找不到活的key时才使用死键，否则'next'会重复访问它
+    */
+    if (dead != NULL)
+      return (cast_int(dead - gnode(t, 0)) + 1) + asize;
+    if (t->old != NULL)  /* old hash part is numbered after the new one */
+      return findindex(L, t->old, key) + asize + sizenode(t);
+    luaG_runerror(L, "invalid key to 'next'");  /* key not found */
+    return 0;  /* to avoid warnings */
+  }
+#else
   else {
     /*
     ** 进入此分支表明key落在了散列表部分，这个时候首先利用key计算出其在散列表的
@@ -248,16 +578,20 @@ static unsigned int findindex (lua_State *L, Table *t, StkId key) {
         ** 处于hash表中的元素索引值是在数组部分之后，故这里需要加上数组的大小，由于
         ** 索引值从1开始，所以这里还需要加上一个1。
 				*/
-        return (i + 1) + t->sizearray;
+        return (i + 1) + asize;
       }
 
       /* 获取下一个处于同一个mainposition的Node节点 */
       nx = gnext(n);
-      if (nx == 0)
+      if (nx != 0)
+        n += nx;
+      else if (t->old != NULL)  /* old hash part is numbered after the new one */
+        return findindex(L, t->old, key) + asize + sizenode(t);
+      else
         luaG_runerror(L, "invalid key to 'next'");  /* key not found */
-      else n += nx;
     }
   }
+#endif
 }
 
 /*
@@ -271,6 +605,10 @@ int luaH_next (lua_State *L, Table *t, StkId key) {
 
   /* 找出key对象在lua表中的索引，详细见findindex()的注解 */
   unsigned int i = findindex(L, t, key);  /* find original element */
+  unsigned int asize = arraysize(t);
+
+  if (ttisnil(key))  /* beginning of a traversal? */
+    starttrav(t);
 
   /*
   ** 首先尝试从lua表中的数组部分查找，如果没有找到，就尝试从散列表部分查找。
@@ -279,6 +617,14 @@ int luaH_next (lua_State *L, Table *t, StkId key) {
   ** 原索引+1。同时将原索引对应的value对象拷贝到key对象之后。这样外层通过调用luaH_next()
   ** 接口就可以得到下一个元素的索引和当前索引对应的元素值。
   */
+  if (istyped(t) && i < asize) {  /* typed array: keys 1..n are present */
+    if (i < typedarray(t)->n) {
+      setivalue(key, i + 1);
+      setobj2s(L, key+1, luaH_getint(t, i + 1));
+      return 1;
+    }
+    i = asize;
+  }
   for (; i < t->sizearray; i++) {  /* try first array part */
     if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
       setivalue(key, i + 1); /* 保存下一个元素的索引 */
@@ -286,23 +632,293 @@ int luaH_next (lua_State *L, Table *t, StkId key) {
       return 1; /* 返回1表示迭代成功，找到了内容 */
     }
   }
-  for (i -= t->sizearray; cast_int(i) < sizenode(t); i++) {  /* hash part */
-    if (!ttisnil(gval(gnode(t, i)))) {  /* a non-nil value? */
+  if (isshaped(t)) {  /* shape part */
+    for (i -= asize; cast_int(i) < t->shape->nkeys; i++) {
+      if (!ttisnil(&t->svals[i])) {
+        setnextpos(t, (i + 1) + asize);
+        setsvalue2s(L, key, t->shape->keys[i]);
+        setobj2s(L, key+1, &t->svals[i]);
+        return 1;
+      }
+    }
+    endtrav(t);
+    return 0;  /* no more elements */
+  }
+  for (i -= asize; cast_int(i) < sizenode(t); i++) {  /* hash part */
+    if (!ttisnil(nval(t, gnode(t, i)))) {  /* a non-nil value? */
 
       /* 这个地方也会保存下一个元素的索引，因为这里将原索引对应的key对象直接保存
       ** 在了参数指定的key中，而我们知道lua表中的散列表中会在每个Node节点的key对象
       ** 中保存下一个Node节点在整个散列数组中的下标，因为这里只需要保存参数key对应
       ** 的Node节点的key对象就可以知道下一个对象的索引值了。
       */
+      setnextpos(t, (i + 1) + asize);  /* 下次从这里继续，不必再查找key */
       setobj2s(L, key, gkey(gnode(t, i)));
-      setobj2s(L, key+1, gval(gnode(t, i))); /* 保存获取到的value对象 */
+      setobj2s(L, key+1, nval(t, gnode(t, i))); /* 保存获取到的value对象 */
       return 1; /* 返回1表示迭代成功，找到了内容 */
     }
   }
+  if (t->old != NULL) {  /* old hash part (while it is being moved) */
+    Table *o = t->old;
+    for (i -= sizenode(t); cast_int(i) < sizenode(o); i++) {
+      if (!ttisnil(nval(o, gnode(o, i)))) {
+        setobj2s(L, key, gkey(gnode(o, i)));
+        setobj2s(L, key+1, nval(o, gnode(o, i)));
+        return 1;
+      }
+    }
+  }
+  endtrav(t);
   return 0;  /* no more elements */
 }
 
 
+/*
+** {=============================================================
+** Typed arrays
+** ==============================================================
+*/
+
+#define tints(ta)	cast(lua_Integer *, (ta) + 1)
+#define tflts(ta)	cast(lua_Number *, (ta) + 1)
+
+
+/* stores number 'v' (of the array's type) as element 'i' of 'ta' */
+#define settypedelem(t,ta,i,v) \
+  ((t)->atype == LUA_TNUMINT ? (void)(tints(ta)[i] = ivalue(v)) \
+                             : (void)(tflts(ta)[i] = fltvalue(v)))
+
+
+/*
+** element 'i' (0-based, < size) of the typed array part of 't', as a
+** TValue: it is copied into 'v', which stays valid until the next access
+** to the array. Readers of 'luaH_getint'/'luaH_get' copy the result out
+** before touching any table again ('luaV_fastget', 'lua_rawget*',
+** 'luaH_next', the inline 'ipairs' of OP_TFORCALL) or only test it for
+** nil ('luaH_getn'). The one writer is 'luaV_fastset', which stores into
+** the copy and commits it before anything else reads the array; the raw
+** setters never get the copy ('luaH_set' boxes the array part first and
+** 'luaH_setint' goes through 'settyped'), as asserted there.
+*/
+static const TValue *gettyped (Table *t, unsigned int i) {
+  TypedArray *ta = typedarray(t);
+  if (i >= ta->n)
+    return luaO_nilobject;
+  ta->i = i;
+  if (t->atype == LUA_TNUMINT) {
+    setivalue(&ta->v, tints(ta)[i]);
+  }
+  else {
+    setfltvalue(&ta->v, tflts(ta)[i]);
+  }
+  return &ta->v;
+}
+
+
+/* if 'key' is an integer (or a float with an integral value), put it in 'k' */
+static int getintkey (const TValue *key, lua_Integer *k) {
+  if (ttisinteger(key)) {
+    *k = ivalue(key);
+    return 1;
+  }
+  else return (ttisfloat(key) && luaV_tointeger(key, k, 0));
+}
+
+
+/*
+** 把类型化数组部分换回普通的TValue数组部分（容量不变）。先分配新数组，
+** 内存错误时表保持原样。
+*/
+static void boxarray (lua_State *L, Table *t) {
+  TypedArray *ta = typedarray(t);
+  unsigned int size = ta->size;
+  unsigned int n = ta->n;
+  unsigned int i;
+  TValue *array = luaM_newvector(L, size, TValue);
+  for (i = 0; i < n; i++) {
+    if (t->atype == LUA_TNUMINT) {
+      setivalue(&array[i], tints(ta)[i]);
+    }
+    else {
+      setfltvalue(&array[i], tflts(ta)[i]);
+    }
+  }
+  for (; i < size; i++)
+    setnilvalue(&array[i]);
+  luaM_freemem(L, ta, typedsize(t->atype, size));
+  t->array = array;
+  t->sizearray = size;
+  t->atype = 0;
+  t->lenhint = n;  /* 1..n present, n + 1 absent (or n == size) */
+  l_setbit(t->marked, NOTYPEBIT);  /* do not type it back at this size */
+}
+
+
+/* true if the hash part of 't' has a value for an integer key in [lo, hi] */
+static int hashhasints (const Table *t, lua_Unsigned lo, lua_Unsigned hi) {
+  int i;
+  if (isdummy(t))  /* empty, or a shape (string keys only)? */
+    return 0;
+  for (i = 0; i < sizenode(t); i++) {
+    const TValue *k = gkey(gnode(t, i));
+    if (ttisinteger(k) && l_castS2U(ivalue(k)) - lo <= hi - lo &&
+        !ttisnil(nval(t, gnode(t, i))))
+      return 1;
+  }
+  return (t->old != NULL && hashhasints(t->old, lo, hi));
+}
+
+
+/*
+** 类型化数组已满时倍增其容量。新范围内的整数key不能已经在散列部分中，
+** 否则把数组换回普通数组部分并返回0。
+*/
+static int growtyped (lua_State *L, Table *t) {
+  unsigned int size = typedarray(t)->size;
+  unsigned int nsize = (size <= MAXASIZE / 2) ? 2 * size : MAXASIZE;
+  if (nsize == size || hashhasints(t, size + 1, nsize)) {
+    boxarray(L, t);
+    return 0;
+  }
+  t->array = cast(TValue *, luaM_realloc_(L, t->array,
+                  typedsize(t->atype, size), typedsize(t->atype, nsize)));
+  typedarray(t)->size = nsize;
+  return 1;
+}
+
+
+/*
+** 把类型化数组的容量缩小到能放下现有元素和下一次追加的最小的2的幂。只在
+** 插入新key时调用（此时没有进行中的遍历），新范围之外的整数key以后进入散列部分。
+*/
+static void shrinktyped (lua_State *L, Table *t) {
+  TypedArray *ta = typedarray(t);
+  unsigned int nsize = 1u << luaO_ceillog2(ta->n + 1);
+  if (nsize < ta->size / 2) {  /* worth it? */
+    t->array = cast(TValue *, luaM_realloc_(L, t->array,
+                    typedsize(t->atype, ta->size), typedsize(t->atype, nsize)));
+    typedarray(t)->size = nsize;
+  }
+}
+
+
+/*
+** Try to do the raw assignment 't[k] = v' in the typed array part of
+** 't'. Returns 1 when done (or when there was nothing to do); returns 0
+** when 'k' belongs to the hash part or when the assignment could not
+** keep the array typed, in which case the array part was boxed and
+** the caller must do a regular assignment.
+*/
+static int settyped (lua_State *L, Table *t, lua_Integer k, const TValue *v) {
+  TypedArray *ta = typedarray(t);
+  lua_Unsigned i = l_castS2U(k) - 1;  /* 0-based index */
+  if (i < ta->n) {  /* existing element? */
+    if (ttype(v) == t->atype) {
+      settypedelem(t, ta, i, v);
+      return 1;
+    }
+    else if (ttisnil(v) && i == ta->n - 1) {  /* removing the last one? */
+      ta->n--;
+      return 1;
+    }
+  }
+  else if (i == ta->n) {  /* appending? */
+    if (ttisnil(v))
+      return 1;  /* nothing to do */
+    else if (ttype(v) == t->atype) {
+      if (testbit(t->marked, SHRINKBIT)) {  /* a new key: can shrink now */
+        shrinktyped(L, t);
+        ta = typedarray(t);
+      }
+      if (i == ta->size && !growtyped(L, t))
+        return 0;  /* array was boxed */
+      ta = typedarray(t);
+      settypedelem(t, ta, i, v);
+      ta->n++;
+      return 1;
+    }
+    else if (i == ta->size)
+      return 0;  /* goes to the hash part; array stays typed */
+  }
+  else if (i >= ta->size)
+    return 0;  /* key belongs to the hash part */
+  else if (ttisnil(v))
+    return 1;  /* erasing an absent element */
+  boxarray(L, t);  /* a hole or a value of another type */
+  return 0;
+}
+
+
+/*
+** Raw assignment 't[key] = val' into a table with a typed array part.
+** Returns NULL if done; otherwise returns the (current) slot for 'key',
+** which may be 'luaO_nilobject', for the caller to finish the job.
+*/
+const TValue *luaH_typedset (lua_State *L, Table *t, const TValue *key,
+                                                     const TValue *val) {
+  lua_Integer k;
+  if (getintkey(key, &k) && settyped(L, t, k, val))
+    return NULL;
+  return luaH_get(t, key);
+}
+
+
+/*
+** The copy 'v' of an element of the typed array part of 't' was just
+** assigned to: store it back (boxing the array part if needed).
+*/
+void luaH_committyped (lua_State *L, Table *t) {
+  TypedArray *ta = typedarray(t);
+  unsigned int i = ta->i;
+  TValue v;
+  lua_assert(i < ta->n);
+  if (ttype(&ta->v) == t->atype)  /* common case: same type */
+    settypedelem(t, ta, i, &ta->v);
+  else {
+    setobj(L, &v, &ta->v);  /* 'settyped' may free the copy */
+    if (!settyped(L, t, i + 1, &v))  /* array was boxed? */
+      setobj2t(L, &t->array[i], &v);
+  }
+}
+
+
+/*
+** 数组部分刚被填满：如果所有元素都是整数（或都是浮点数），就把它换成
+** 类型化数组。调用者持有的数组槽位指针随之失效。不成功时设置NOTYPEBIT，
+** 数组部分改变大小之前不再尝试，所以在满数组末尾反复删除、追加不会每次都
+** 扫描整个数组。
+*/
+void luaH_trytype (lua_State *L, Table *t) {
+  unsigned int size = t->sizearray;
+  int tt = ttype(&t->array[size - 1]);
+  unsigned int i;
+  TypedArray *ta;
+  if (tt != LUA_TNUMINT && tt != LUA_TNUMFLT) {
+    l_setbit(t->marked, NOTYPEBIT);
+    return;
+  }
+  for (i = size - 1; i-- > 0; ) {  /* backwards: mixed arrays fail early */
+    if (ttype(&t->array[i]) != tt) {
+      l_setbit(t->marked, NOTYPEBIT);
+      return;
+    }
+  }
+  ta = cast(TypedArray *, luaM_malloc(L, typedsize(tt, size)));
+  t->atype = cast_byte(tt);
+  for (i = 0; i < size; i++)
+    settypedelem(t, ta, i, &t->array[i]);
+  setnilvalue(&ta->v);
+  ta->i = 0;
+  ta->n = ta->size = size;
+  luaM_freearray(L, t->array, size);
+  t->array = cast(TValue *, ta);
+  t->sizearray = 0;
+  t->lenhint = 0;
+}
+
+/* }============================================================= */
+
+
 /*
 ** {=============================================================
 ** Rehash
@@ -391,10 +1007,12 @@ static int numusehash (const Table *t, unsigned int *nums, unsigned int *pna) {
   int totaluse = 0;  /* total number of elements */
   int ause = 0;  /* elements added to 'nums' (can go to array part) */
   int i = sizenode(t);
+  if (isshaped(t))  /* only string keys, none can go to the array part */
+    return shapeuse(t);
   while (i--) {
     Node *n = &t->node[i];
     //只需看value不为nil，为nil即deadkey
-    if (!ttisnil(gval(n))) {
+    if (!ttisnil(nval(t, n))) {
       ause += countint(gkey(n), nums);
       totaluse++;
     }
@@ -421,6 +1039,39 @@ static void setarrayvector (lua_State *L, Table *t, unsigned int size) {
 ** 所需要的内存，并对散列数组做一个初始化，即在初始情况下，散列数组中的每个Node都没有后继
 ** 的Node，并将Node中的key和value信息设置为nil。
 */
+#if defined(LUA_SWISSTABLE)
+static void setnodevector (lua_State *L, Table *t, unsigned int size) {
+  if (size == 0) {  /* no elements to hash part? */
+    t->node = cast(Node *, dummynode);  /* use common 'dummynode' */
+    t->lsizenode = 0;
+    t->hvals = cast(TValue *, luaO_nilobject);  /* never written */
+    t->ctrl = cast(lu_byte *, luaH_emptyctrl_);  /* signal the dummy node */
+    t->growthleft = 0;  /* first key will rehash */
+  }
+  else {
+    int i;
+    int lsize = luaO_ceillog2(size);
+    /* 按最大负载留出空槽 */
+    if (lsize <= MAXHBITS && cast(unsigned int, maxload(twoto(lsize))) < size)
+      lsize++;
+    if (lsize > MAXHBITS)
+      luaG_runerror(L, "table overflow");
+    size = twoto(lsize);
+    t->node = luaM_newvector(L, nodevecsize(size), Node);
+    t->hvals = cast(TValue *, t->node + size);  /* after the keys */
+    for (i = 0; i < (int)size; i++) {
+      Node *n = gnode(t, i);
+      gnext(n) = 0;
+      setnilvalue(wgkey(n));
+      setnilvalue(&t->hvals[i]);
+    }
+    t->ctrl = cast(lu_byte *, t->hvals + size);  /* after the values */
+    memset(t->ctrl, CTRLEMPTY, ctrlsize(size));
+    t->lsizenode = cast_byte(lsize);
+    t->growthleft = maxload(size);
+  }
+}
+#else
 static void setnodevector (lua_State *L, Table *t, unsigned int size) {
   if (size == 0) {  /* no elements to hash part? */
     t->node = cast(Node *, dummynode);  /* use common 'dummynode' */
@@ -456,6 +1107,33 @@ static void setnodevector (lua_State *L, Table *t, unsigned int size) {
     t->lastfree = gnode(t, size);  /* all positions are free */
   }
 }
+#endif
+
+
+#if defined(LUA_SWISSTABLE)
+/*
+** 把旧散列部分的项插入新的散列部分。这些key互不相同，也不在新表中，散列值
+** 保存在key里，所以不需要查找也不需要重新计算散列值；只有可能进入数组部分
+** 的整数key要先检查数组部分。
+*/
+static void reinsert (lua_State *L, Table *t, Node *nold, const TValue *vold,
+                      int oldhsize) {
+  int j;
+  for (j = 0; j < oldhsize; j++) {
+    const TValue *key = gkey(nold + j);
+    if (ttisnil(&vold[j]))
+      continue;  /* empty entry */
+    if (ttisinteger(key) && l_castS2U(ivalue(key)) - 1 < t->sizearray) {
+      setobjt2t(L, &t->array[ivalue(key) - 1], &vold[j]);
+    }
+    else {
+      Node *n = getfreepos(t, nodehash(nold + j));
+      setnodekey(L, &n->i_key, key);
+      setobjt2t(L, nval(t, n), &vold[j]);
+    }
+  }
+}
+#endif
 
 
 typedef struct {
@@ -470,21 +1148,156 @@ static void auxsetnode (lua_State *L, void *ud) {
   setnodevector(L, asn->t, asn->nhsize);
 }
 
-/* 根据参数指定的数组部分大小和散列表部分的大小为table重新设置数组部分和散列表部分 */
-void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
-                                          unsigned int nhsize) {
+static TValue *newkey (lua_State *L, Table *t, const TValue *key);
+
+
+/* free the old hash part 'o' (its entries were moved or are dead) */
+static void freeold (lua_State *L, Table *o) {
+  lua_assert(!isdummy(o) && o->old == NULL);
+  luaM_freearray(L, o->node, nodevecsize(cast(size_t, sizenode(o))));
+  luaM_free(L, cast(OldHash *, o));
+}
+
+
+/* move all entries of old hash part 'o' into 't', which has room for them */
+static void mergeold (lua_State *L, Table *t, Table *o) {
+#if defined(LUA_SWISSTABLE)
+  reinsert(L, t, o->node, o->hvals, sizenode(o));
+#else
+  int j;
+  for (j = 0; j < sizenode(o); j++) {
+    Node *old = gnode(o, j);
+    if (!ttisnil(gval(old)))
+      setobjt2t(L, luaH_set(L, t, gkey(old)), gval(old));
+  }
+#endif
+  freeold(L, o);
+}
+
+
+/*
+** 增量地把't'的散列部分换成能放下'nhsize'个key的新散列部分：旧的Node数组
+** 交给't->old'，此后由'moveold'逐步搬走。每个新key搬动的节点数保证旧散列
+** 部分在新散列部分被填满之前搬完，否则下一次rehash只能一次性合并。
+*/
+static void startmove (lua_State *L, Table *t, unsigned int nhsize) {
+  OldHash *oh = luaM_new(L, OldHash);
+  Table *o = &oh->h;
+  AuxsetnodeT asn;
+  unsigned int room;
+  *o = *t;  /* keep the hash part... */
+  o->sizearray = 0;  /* ...but nothing else */
+  o->array = NULL;
+  o->atype = 0;
+  o->shape = NULL;
+  o->svals = NULL;
+  o->metatable = NULL;
+  asn.t = t; asn.nhsize = nhsize;
+  if (luaD_rawrunprotected(L, auxsetnode, &asn) != LUA_OK) {  /* mem. error? */
+    luaM_free(L, oh);
+    luaD_throw(L, LUA_ERRMEM);  /* rethrow memory error */
+  }
+#if defined(LUA_SWISSTABLE)
+  room = t->growthleft;
+#else
+  room = sizenode(t);
+#endif
+  room -= nhsize;  /* new keys that fit while the old ones are moved */
+  oh->moved = 0;
+  oh->step = sizenode(o) / (room + 1) + MOVESTEP;
+  t->old = o;
+}
+
+
+/*
+** 从旧散列部分搬动下一段节点到新散列部分。先插入再清除旧的value，这样
+** 如果插入时新散列部分已满而触发了（一次性的）rehash，旧的项也已经被合并了。
+*/
+static void moveold (lua_State *L, Table *t) {
+  Table *o = t->old;
+  unsigned int i = oldhash(t)->moved;
+  unsigned int lim = i + oldhash(t)->step;
+  if (lim > cast(unsigned int, sizenode(o)))
+    lim = sizenode(o);
+  for (; i < lim; i++) {
+    Node *n = gnode(o, i);
+    TValue *v = nval(o, n);
+    if (!ttisnil(v)) {
+      TValue k;
+      TValue *slot;
+      setobj(L, &k, gkey(n));  /* 'o' may be gone after 'newkey' */
+      slot = newkey(L, t, &k);
+      if (t->old != o)  /* rehashed everything? */
+        return;  /* (entry was merged too) */
+      setobjt2t(L, slot, v);
+      setnilvalue(v);
+    }
+  }
+  if (i < cast(unsigned int, sizenode(o)))
+    oldhash(t)->moved = i;
+  else {  /* all moved */
+    t->old = NULL;
+    freeold(L, o);
+  }
+}
+
+
+/*
+** 根据参数指定的数组部分大小和散列表部分的大小为table重新设置数组部分和散列表部分。
+** 'keepshape'为0时，形状模式的表总是换成Node数组（见'compact'）。
+*/
+static void resize (lua_State *L, Table *t, unsigned int nasize,
+                    unsigned int nhsize, int keepshape) {
   unsigned int i;
   int j;
   AuxsetnodeT asn;
+  unsigned int oldasize;
+  int oldhsize;
+  Node *nold;
+#if defined(LUA_SWISSTABLE)
+  TValue *hvold;
+#endif
+  Shape *sold;
+  TValue *vold;
+  Table *o;  /* old hash part of an incremental resize, if any */
+
+  if (istyped(t) && nasize > 0)  /* new array part: box the old one */
+    boxarray(L, t);
 
   /* 保存表中数组的原始大小 */
-  unsigned int oldasize = t->sizearray;
+  oldasize = t->sizearray;
+  if (nasize != oldasize)  /* a new size can be typed again */
+    resetbit(t->marked, NOTYPEBIT);
 
   /* 保存lua表中散列表部分的散列数组的原始大小 */
-  int oldhsize = allocsizenode(t);
+  oldhsize = allocsizenode(t);
 
   /* 保存旧的散列表数组 */
-  Node *nold = t->node;  /* save old hash ... */
+  nold = t->node;  /* save old hash ... */
+#if defined(LUA_SWISSTABLE)
+  hvold = t->hvals;
+#endif
+
+  /* 形状模式下旧的key和value */
+  sold = t->shape;
+  vold = t->svals;
+
+  if (t->lenhint > nasize)  /* keep the hint inside the array part */
+    t->lenhint = nasize;
+
+  if (keepshape && sold != NULL &&
+      nhsize == cast(unsigned int, shapeuse(t))) {
+    /* 散列部分的key不变（新key进入数组部分）：保持形状，只调整数组部分 */
+    if (nasize > oldasize)
+      setarrayvector(L, t, nasize);
+    else if (nasize < oldasize) {
+      for (i = nasize; i < oldasize; i++)  /* 'rehash' counted none here */
+        lua_assert(ttisnil(&t->array[i]));
+      t->sizearray = nasize;
+      luaM_reallocvector(L, t->array, oldasize, nasize, TValue);
+    }
+    return;
+  }
 
   /* 如果参数指定的数组大小大于数组的原始大小，那么就对数组部分进行扩容 */
   if (nasize > oldasize)  /* array part must grow? */
@@ -498,6 +1311,10 @@ void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
     setarrayvector(L, t, oldasize);  /* array back to its original size */
     luaD_throw(L, LUA_ERRMEM);  /* rethrow memory error */
   }
+  t->shape = NULL;  /* hash part is now a 'Node' array */
+  t->svals = NULL;
+  o = t->old;  /* its entries go to the new hash part too */
+  t->old = NULL;
 
 	/* 如果参数指定的数组大小小于数组的原始大小，那么就对数组部分进行缩容 */
   
@@ -515,6 +1332,9 @@ void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
   }
   /* re-insert elements from hash part */
   /* 将旧的散列表中的内容插入到新的散列表中 */
+#if defined(LUA_SWISSTABLE)
+  reinsert(L, t, nold, hvold, oldhsize);
+#else
   for (j = oldhsize - 1; j >= 0; j--) {
     Node *old = nold + j;
     if (!ttisnil(gval(old))) {
@@ -524,15 +1344,42 @@ void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
       setobjt2t(L, luaH_set(L, t, gkey(old)), gval(old));
     }
   }
+#endif
+
+  /* 形状模式下的key和value也要插入到新的散列表中 */
+  if (sold != NULL) {
+    for (j = 0; j < sold->nkeys; j++) {
+      if (!ttisnil(&vold[j])) {
+        TValue k;
+        setsvalue(L, &k, sold->keys[j]);
+        setobjt2t(L, luaH_set(L, t, &k), &vold[j]);
+      }
+    }
+    luaM_freearray(L, vold, shapecap(sold->nkeys));
+  }
+
+  if (o != NULL)
+    mergeold(L, t, o);
 
   /* 如果旧的散列表非空，那么需要释放散列数组的内存 */
   if (oldhsize > 0)  /* not the dummy node? */
-    luaM_freearray(L, nold, cast(size_t, oldhsize)); /* free old hash */
+    luaM_freearray(L, nold, nodevecsize(cast(size_t, oldhsize))); /* free old hash */
+}
+
+
+void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
+                                          unsigned int nhsize) {
+  resize(L, t, nasize, nhsize, 1);
 }
 
 /* 根据参数指定的大小对table中的数组部分进行调整 */
 void luaH_resizearray (lua_State *L, Table *t, unsigned int nasize) {
-  int nsize = allocsizenode(t);
+  int nsize;
+  if (istyped(t) && nasize <= typedarray(t)->size)
+    return;  /* typed array is already large enough */
+  nsize = isshaped(t) ? shapeuse(t) : allocsizenode(t);
+  if (t->old != NULL)  /* room for the keys not moved yet */
+    nsize += allocsizenode(t->old);
   luaH_resize(L, t, nasize, nsize);
 }
 
@@ -563,12 +1410,72 @@ static void rehash (lua_State *L, Table *t, const TValue *ek) {
   totaluse = na;  /* all those keys are integer keys */
   //deadkey会在rehash内清理
   totaluse += numusehash(t, nums, &na);  /* count keys in hash part */
+  if (t->old != NULL)  /* keys not moved yet by an incremental resize */
+    totaluse += numusehash(t->old, nums, &na);
   na += countint(ek, nums);/* count extra key */
   totaluse++;/* count extra key */
   
   /* compute new size for array part */
-  asize = computesizes(nums, &na);
-  /* resize the table to new computed sizes */
+  if (istyped(t)) {  /* keep the typed array; resize only the hash part */
+    asize = 0;
+    na = 0;
+  }
+  else
+    asize = computesizes(nums, &na);
+  /* a large hash part with the same array part can be resized incrementally
+     (but not while it is still being moved) */
+  if (t->old == NULL && asize == t->sizearray &&
+      allocsizenode(t) >= LUAI_MINHASHMOVE)
+    startmove(L, t, totaluse - na);
+  else  /* resize the table to new computed sizes */
+    luaH_resize(L, t, asize, totaluse - na);
+}
+
+
+/*
+** 把't'缩小到它现有的key（加上正要插入的'ek'）所需的大小，数组部分不会变大。
+** 由GC在清扫阶段调用时'ek'为NULL（见lgc.c的shrinktable），此时没有进行中的
+** 遍历，紧急GC是关闭的，内存错误时'luaH_resize'把't'恢复原样。GC没能收缩
+** 的表在插入新key时调用：这时不允许有进行中的遍历，所以可以像'rehash'一样
+** 重排它，大的散列部分用'startmove'增量地换成小的（数组部分不变），不会
+** 一次重新插入所有的key。GC总是一次完成，它的工作量计入清扫的步长。
+*/
+void luaH_shrink (lua_State *L, Table *t, const TValue *ek) {
+  unsigned int asize;
+  unsigned int na;
+  unsigned int nh;
+  unsigned int totaluse;
+  unsigned int nums[MAXABITS + 1];
+  int i;
+  resetbit(t->marked, SHRINKBIT);
+  if (t->old != NULL || isshaped(t))
+    return;
+  if (istyped(t))
+    shrinktyped(L, t);
+  for (i = 0; i <= MAXABITS; i++) nums[i] = 0;  /* reset counts */
+  na = numusearray(t, nums);
+  totaluse = na;
+  nh = cast(unsigned int, numusehash(t, nums, &na));  /* keys in hash part */
+  if (ek != NULL && allocsizenode(t) >= LUAI_MINHASHMOVE) {  /* large? */
+    if (nh + 1 < allocsizenode(t) / 4u)
+      startmove(L, t, nh + 1);  /* (with room for 'ek') */
+    return;
+  }
+  totaluse += nh;
+  if (ek != NULL) {
+    na += countint(ek, nums);  /* count extra key */
+    totaluse++;
+  }
+  if (istyped(t)) {  /* typed array part is kept */
+    asize = 0;
+    na = 0;
+  }
+  else
+    asize = computesizes(nums, &na);
+  if (asize > t->sizearray)  /* would move keys into the array part? */
+    return;  /* not a shrink */
+  if (asize > t->sizearray / 2 && totaluse - na >= allocsizenode(t) / 4u)
+    return;  /* neither part would get much smaller */
   luaH_resize(L, t, asize, totaluse - na);
 }
 
@@ -579,14 +1486,521 @@ static void rehash (lua_State *L, Table *t, const TValue *ek) {
 */
 
 
+/*
+** {=============================================================
+** Shapes
+** ==============================================================
+*/
+
+/*
+** 调整'g->shapes'的桶数，做法与'luaS_resize'相同：先扩容再重新散列，
+** 缩容时先重新散列再释放多余的桶。
+*/
+void luaH_resizeshapes (lua_State *L, int newsize) {
+  int i;
+  shapetable *tb = &G(L)->shapes;
+  if (newsize > tb->size) {  /* grow table if needed */
+    luaM_reallocvector(L, tb->hash, tb->size, newsize, Shape *);
+    for (i = tb->size; i < newsize; i++)
+      tb->hash[i] = NULL;
+  }
+  for (i = 0; i < tb->size; i++) {  /* rehash */
+    Shape *p = tb->hash[i];
+    tb->hash[i] = NULL;
+    while (p) {  /* for each node in the list */
+      Shape *hnext = p->hnext;  /* save next */
+      unsigned int h = lmod(p->hash, newsize);  /* new position */
+      p->hnext = tb->hash[h];  /* chain it */
+      tb->hash[h] = p;
+      p = hnext;
+    }
+  }
+  if (newsize < tb->size) {  /* shrink table if needed */
+    /* vanishing slice should be empty */
+    lua_assert(tb->hash[newsize] == NULL && tb->hash[tb->size - 1] == NULL);
+    luaM_reallocvector(L, tb->hash, tb->size, newsize, Shape *);
+  }
+  tb->size = newsize;
+}
+
+
+/*
+** 释放所有形状，在'lua_close'中所有表都释放之后调用
+*/
+void luaH_freeshapes (lua_State *L) {
+  shapetable *tb = &G(L)->shapes;
+  int i;
+  for (i = 0; i < tb->size; i++) {
+    Shape *p = tb->hash[i];
+    while (p) {
+      Shape *hnext = p->hnext;
+      luaM_freemem(L, p, sizeshape(p->nkeys));
+      p = hnext;
+    }
+  }
+  luaM_freearray(L, tb->hash, tb->size);
+}
+
+
+/*
+** 返回在形状's'（NULL表示没有key）之后追加'key'得到的形状。形状按整个key
+** 序列驻留，已存在的（哪怕已经被判定为垃圾但还没被清扫）直接复用。
+*/
+static Shape *getshape (lua_State *L, Shape *s, TString *key) {
+  global_State *g = G(L);
+  shapetable *tb = &g->shapes;
+  int n = (s == NULL) ? 0 : s->nkeys;
+  unsigned int h = (s == NULL) ? g->seed : s->hash;
+  Shape *ns;
+  Shape **list;
+  int i;
+  h ^= (h << 5) + (h >> 2) + key->hash;
+  if (tb->size > 0) {
+    for (ns = tb->hash[lmod(h, tb->size)]; ns != NULL; ns = ns->hnext) {
+      if (ns->hash == h && ns->nkeys == n + 1 && ns->keys[n] == key &&
+          (n == 0 || memcmp(ns->keys, s->keys, n * sizeof(TString *)) == 0)) {
+        if (isdead(g, obj2gco(ns)))  /* dead (but not collected yet)? */
+          changewhite(obj2gco(ns));  /* resurrect it */
+        return ns;
+      }
+    }
+  }
+  if (tb->nuse >= tb->size)  /* need to grow shape table? */
+    luaH_resizeshapes(L, (tb->size == 0) ? MINSHAPETABSIZE : tb->size * 2);
+  /* not in 'allgc': shapes are swept with the shape table (see 'lgc.c') */
+  ns = cast(Shape *, luaM_newobject(L, LUA_TSHAPE, sizeshape(n + 1)));
+  ns->next = NULL;
+  ns->tt = LUA_TSHAPE;
+  ns->marked = luaC_white(g);
+  ns->nkeys = cast_byte(n + 1);
+  ns->hash = h;
+  for (i = 0; i < n; i++)
+    ns->keys[i] = s->keys[i];
+  ns->keys[n] = key;
+  list = &tb->hash[lmod(h, tb->size)];  /* allocation may have swept */
+  ns->hnext = *list;
+  *list = ns;
+  tb->nuse++;
+  return ns;
+}
+
+
+/*
+** 为形状模式（或散列部分为空）的表't'加入新的短字符串key，返回新槽位的value
+** （已置为nil）。先扩大'svals'再取新形状：两次分配之间表始终是一致的，而新
+** 形状一旦得到就立刻被't'引用，不会被回收。
+*/
+static TValue *shapenewkey (lua_State *L, Table *t, TString *key) {
+  int n = isshaped(t) ? t->shape->nkeys : 0;
+  Shape *ns;
+  lua_assert(isdummy(t) && n < MAXSHAPEKEYS);
+  if (shapecap(n + 1) != shapecap(n))  /* value array is full? */
+    luaM_reallocvector(L, t->svals, shapecap(n), shapecap(n + 1), TValue);
+  ns = getshape(L, t->shape, key);
+  setnilvalue(&t->svals[n]);
+  t->shape = ns;
+  luaC_objbarrier(L, t, ns);
+  return &t->svals[n];
+}
+
+/*
+** }=============================================================
+*/
+
+
+/*
+** {=============================================================
+** Frozen tables
+** ==============================================================
+*/
+
+/*
+** 冻结分两步：先在保护模式下遍历表树（'dofreeze'），检查其中的值，把每个表
+** 压缩成恰好放下它的key的普通形式（没有形状、类型化数组和旧散列部分），并预先
+** 算好读取时才会写入的字段（'lenhint'、元方法的'flags'和长字符串的散列值）。
+** 遍历时GC停在GCSpause，所有对象都是白色的：访问过的表变成灰色，用'gclist'
+** 串起来；新遇到的字符串直接设上FROZENBIT。遍历成功后表也设上FROZENBIT，
+** 由'luaC_takefrozen'把它们从GC链表中取出放进映像；失败时恢复原来的颜色和标记。
+** 遍历中出错不能调用'luaG_runerror'（它可能运行消息处理函数，进而运行GC），
+** 所以只记下消息，恢复之后再报错。
+*/
+typedef struct FreezeState {
+  lua_Frozen *f;
+  GCObject *todo;  /* tables still to be traversed (by 'gclist') */
+  GCObject *done;  /* tables already traversed */
+  int nstrs;  /* number of short strings new to this image */
+  const char *msg;  /* error message (a format with one '%s') */
+  const char *what;
+} FreezeState;
+
+
+static l_noret frozenerror (lua_State *L) {
+  luaG_runerror(L, "attempt to modify a frozen table");
+}
+
+
+static l_noret freezeerror (lua_State *L, FreezeState *fs, const char *msg,
+                                                           const char *what) {
+  fs->msg = msg;
+  fs->what = what;
+  luaD_throw(L, LUA_ERRRUN);
+}
+
+
+static void marktable (FreezeState *fs, Table *t) {
+  if (iswhite(t)) {  /* not seen yet and not in another image? */
+    resetbits(t->marked, WHITEBITS);  /* gray */
+    t->gclist = fs->todo;
+    fs->todo = obj2gco(t);
+  }
+}
+
+
+static void freezevalue (lua_State *L, FreezeState *fs, const TValue *o) {
+  switch (ttype(o)) {
+    case LUA_TNIL: case LUA_TBOOLEAN: case LUA_TLIGHTUSERDATA:
+    case LUA_TLCF: case LUA_TNUMINT: case LUA_TNUMFLT:
+      break;
+    case LUA_TSHRSTR: {
+      TString *ts = tsvalue(o);
+      if (!isfrozen(ts)) {
+        l_setbit(ts->marked, FROZENBIT);
+        fs->nstrs++;
+      }
+      break;
+    }
+    case LUA_TLNGSTR: {
+      TString *ts = tsvalue(o);
+      if (!isfrozen(ts)) {
+        luaS_flat(L, ts);  /* no pieces shared with other strings */
+        luaS_hashlongstr(ts);  /* readers would write the hash */
+        l_setbit(ts->marked, FROZENBIT);
+      }
+      break;
+    }
+    case LUA_TTABLE:
+      marktable(fs, hvalue(o));
+      break;
+    default:
+      freezeerror(L, fs, "cannot freeze a %s value", ttypename(ttnov(o)));
+  }
+}
+
+
+/*
+** 把't'变成普通的Node数组形式：形状属于冻结它的状态的GC（见'getshape'），
+** 类型化数组和增量rehash都会在读取以外的操作中改变表，散列部分一半以上是空的
+** 也顺便缩小。
+*/
+static void compact (lua_State *L, Table *t) {
+  unsigned int asize;
+  unsigned int na;
+  unsigned int nums[MAXABITS + 1];
+  int i;
+  int totaluse;
+  if (istyped(t))
+    boxarray(L, t);
+  for (i = 0; i <= MAXABITS; i++) nums[i] = 0;  /* reset counts */
+  na = numusearray(t, nums);
+  totaluse = na;
+  totaluse += numusehash(t, nums, &na);
+  if (t->old != NULL)
+    totaluse += numusehash(t->old, nums, &na);
+  asize = computesizes(nums, &na);
+  if (isshaped(t) || t->old != NULL || asize != t->sizearray ||
+      cast(unsigned int, totaluse) - na < allocsizenode(t) / 2u)
+    resize(L, t, asize, totaluse - na, 0);
+}
+
+
+/*
+** 预先写好读取时才会写入的字段：'#'的结果留在'lenhint'中，之后'luaH_getn'
+** 直接命中；表被用作元表时，不存在的元方法已在'flags'中记下（'luaT_gettm'
+** 不会再写）；WATCHBIT让所有写入都经过'luaH_unwatch'。
+*/
+static void presetfields (global_State *g, Table *t) {
+  int e;
+  lu_byte flags = cast_byte(~0u);  /* all events absent, watched */
+  luaH_getn(t);
+  for (e = 0; e <= TM_EQ; e++) {
+    if (!ttisnil(luaH_getshortstr(t, g->tmname[e])))
+      flags &= cast_byte(~(1u << e));
+  }
+  t->flags = flags;
+  t->nextpos = 0;
+  t->ntrav = 0;
+}
+
+
+static void traverse (lua_State *L, FreezeState *fs, Table *t) {
+  global_State *g = G(L);
+  unsigned int i;
+  if (t->metatable != NULL) {
+    Table *mt = t->metatable;
+    if (!ttisnil(luaH_getshortstr(mt, g->tmname[TM_GC])) ||
+        !ttisnil(luaH_getshortstr(mt, g->tmname[TM_MODE])))
+      freezeerror(L, fs, "cannot freeze a table with a %s metamethod",
+                         "'__gc' or '__mode'");
+    marktable(fs, mt);
+  }
+  for (i = 0; i < t->sizearray; i++)
+    freezevalue(L, fs, &t->array[i]);
+  if (!isdummy(t)) {
+    Node *n, *limit = gnode(t, cast(size_t, sizenode(t)));
+    for (n = gnode(t, 0); n < limit; n++) {
+      if (!ttisnil(nval(t, n))) {
+        freezevalue(L, fs, gkey(n));
+        freezevalue(L, fs, nval(t, n));
+      }
+    }
+  }
+}
+
+
+static void dofreeze (lua_State *L, void *ud) {
+  FreezeState *fs = cast(FreezeState *, ud);
+  global_State *g = G(L);
+  lua_Frozen *f = fs->f;
+  int size = 0;
+  luaM_growvector(L, g->frozen, g->nfrozen, g->sizefrozen, lua_Frozen *,
+                  MAX_INT, "frozen tables");
+  f->deps = luaM_newvector(L, g->nfrozen, lua_Frozen *);
+  f->ndeps = g->nfrozen;
+  marktable(fs, f->root);
+  while (fs->todo != NULL) {
+    Table *t = gco2t(fs->todo);
+    fs->todo = t->gclist;
+    t->gclist = fs->done;
+    fs->done = obj2gco(t);
+    compact(L, t);
+    presetfields(g, t);
+    traverse(L, fs, t);
+  }
+  if (fs->nstrs > 0) {  /* create the set of its short strings */
+    size = 1;
+    while (size < 2 * fs->nstrs)  /* load factor at most 1/2 */
+      size <<= 1;
+    f->strs = luaM_newvector(L, size, TString *);
+    memset(f->strs, 0, size * sizeof(TString *));
+  }
+  f->sizestrs = size;
+}
+
+
+static void addimagestr (lua_Frozen *f, TString *ts) {
+  unsigned int mask = cast(unsigned int, f->sizestrs - 1);
+  unsigned int i = ts->hash & mask;
+  while (f->strs[i] != NULL)
+    i = (i + 1) & mask;
+  f->strs[i] = ts;
+}
+
+
+/* frees blocks of an image, which are outside the accounting of any state */
+#define freeblock(f,p,sz) \
+	((sz) > 0 ? (void)(*(f)->frealloc)((f)->ud, (p), (sz), 0) : (void)0)
+
+/*
+** Returns the memory used by object 'o' of an image and, if 'f' is not
+** NULL, frees it.
+*/
+static size_t imageobj (lua_Frozen *f, GCObject *o) {
+  switch (o->tt) {
+    case LUA_TTABLE: {
+      Table *t = gco2t(o);
+      size_t ns = isdummy(t) ? 0
+                : nodevecsize(cast(size_t, sizenode(t))) * sizeof(Node);
+      size_t as = t->sizearray * sizeof(TValue);
+      if (f != NULL) {
+        freeblock(f, t->node, ns);
+        freeblock(f, t->array, as);
+        freeblock(f, t, sizeof(Table));
+      }
+      return sizeof(Table) + ns + as;
+    }
+    case LUA_TSHRSTR: {
+      size_t sz = sizelstring(gco2ts(o)->shrlen);
+      if (f != NULL) freeblock(f, o, sz);
+      return sz;
+    }
+    case LUA_TLNGSTR: {
+      TString *ts = gco2ts(o);
+      if (!isrope(ts)) {
+        size_t sz = sizelstring(ts->u.lnglen);
+        if (f != NULL) freeblock(f, o, sz);
+        return sz;
+      }
+      else {  /* a flattened rope (see 'freezevalue') */
+        size_t fs = ts->u.lnglen + 1;
+        if (f != NULL) {
+          freeblock(f, getrope(ts)->flat, fs);
+          freeblock(f, o, sizerope);
+        }
+        return sizerope + fs;
+      }
+    }
+    default: lua_assert(0); return 0;
+  }
+}
+
+
+static void freeimage (lua_Frozen *f) {
+  GCObject *o = f->objs;
+  int i;
+  while (o != NULL) {
+    GCObject *next = o->next;
+    imageobj(f, o);
+    o = next;
+  }
+  for (i = 0; i < f->ndeps; i++)
+    luaH_release(f->deps[i]);
+  freeblock(f, f->deps, f->ndeps * sizeof(lua_Frozen *));
+  if (f->map != NULL)  /* a loaded image? ('strs' is in 'map') */
+    (*f->release)(f->releaseud, f->map, f->sizemap, 0);
+  else
+    freeblock(f, f->strs, f->sizestrs * sizeof(TString *));
+  (*f->frealloc)(f->ud, f, sizeof(lua_Frozen), 0);
+}
+
+
+/*
+** Freezes the tree of tables with root 't' into a new image, which
+** the state keeps (one reference) and also returns (another reference).
+** Freezing a table that is already the root of an image used by the
+** state returns that image; freezing any other frozen table returns
+** NULL. The new image depends on all images already used by the state,
+** as its tables may refer to their objects.
+*/
+lua_Frozen *luaH_freeze (lua_State *L, Table *t) {
+  global_State *g = G(L);
+  FreezeState fs;
+  lua_Frozen *f;
+  lu_byte oldstopem;
+  size_t bytes;
+  GCObject *o;
+  int i, status;
+  if (isfrozen(t)) {
+    for (i = 0; i < g->nfrozen; i++) {
+      if (g->frozen[i]->root == t) {
+        luai_refinc(g->frozen[i]->nref);
+        return g->frozen[i];
+      }
+    }
+    return NULL;  /* part of another image */
+  }
+  luaC_runtilstate(L, bitmask(GCSpause));  /* all objects are white */
+  f = luaM_new(L, lua_Frozen);
+  f->root = t;
+  f->objs = NULL;
+  f->strs = NULL;
+  f->deps = NULL;
+  f->frealloc = g->frealloc;
+  f->ud = g->ud;
+  f->seed = g->seed;
+  f->sizestrs = f->ndeps = 0;
+  f->nref = 2;  /* the state and the caller */
+  f->map = NULL;
+  fs.f = f;
+  fs.todo = fs.done = NULL;
+  fs.nstrs = 0;
+  oldstopem = g->gcstopem;
+  g->gcstopem = 1;  /* no collection while there are gray tables */
+  status = luaD_rawrunprotected(L, dofreeze, &fs);
+  g->gcstopem = oldstopem;
+  if (status != LUA_OK) {  /* undo the marks */
+    GCObject *lists[2];
+    lists[0] = fs.todo; lists[1] = fs.done;
+    for (i = 0; i < 2; i++) {
+      for (o = lists[i]; o != NULL; o = gco2t(o)->gclist)
+        o->marked |= luaC_white(g);  /* gray back to white */
+    }
+    luaC_takefrozen(L, NULL);
+    luaM_freearray(L, f->strs, f->sizestrs);
+    luaM_freearray(L, f->deps, f->ndeps);
+    luaM_free(L, f);
+    if (status == LUA_ERRRUN)
+      luaG_runerror(L, fs.msg, fs.what);
+    luaD_throw(L, status);
+  }
+  for (o = fs.done; o != NULL; o = gco2t(o)->gclist)
+    l_setbit(o->marked, FROZENBIT);
+  luaC_takefrozen(L, &f->objs);
+  bytes = sizeof(lua_Frozen) + f->sizestrs * sizeof(TString *) +
+          f->ndeps * sizeof(lua_Frozen *);
+  for (o = f->objs; o != NULL; o = o->next) {
+    bytes += imageobj(NULL, o);
+    if (o->tt == LUA_TSHRSTR) {  /* found through the image from now on */
+      luaS_remove(L, gco2ts(o));
+      addimagestr(f, gco2ts(o));
+    }
+  }
+  g->totalbytes -= bytes;  /* the image is not part of the state anymore */
+  for (i = 0; i < f->ndeps; i++) {
+    f->deps[i] = g->frozen[i];
+    luai_refinc(f->deps[i]->nref);
+  }
+  g->frozen[g->nfrozen++] = f;  /* space reserved by 'dofreeze' */
+  return f;
+}
+
+
+/*
+** Makes image 'f' (and the images it depends on) usable by the state:
+** its short strings become the strings of the state with their contents.
+*/
+void luaH_attach (lua_State *L, lua_Frozen *f) {
+  global_State *g = G(L);
+  int i;
+  for (i = 0; i < g->nfrozen; i++) {
+    if (g->frozen[i] == f)
+      return;  /* already in use */
+  }
+  for (i = 0; i < f->ndeps; i++)
+    luaH_attach(L, f->deps[i]);
+  luaM_growvector(L, g->frozen, g->nfrozen, g->sizefrozen, lua_Frozen *,
+                  MAX_INT, "frozen tables");
+  luaS_adopt(L, f);
+  luai_refinc(f->nref);
+  g->frozen[g->nfrozen++] = f;
+}
+
+
+/* drops a reference to image 'f'; the last one frees it */
+void luaH_release (lua_Frozen *f) {
+  if (luai_refdec(f->nref) == 0)
+    freeimage(f);
+}
+
+
+/* drops the references of a state that is being closed */
+void luaH_releaseimages (lua_State *L) {
+  global_State *g = G(L);
+  int i;
+  for (i = 0; i < g->nfrozen; i++)
+    luaH_release(g->frozen[i]);
+  luaM_freearray(L, g->frozen, g->sizefrozen);
+}
+
+/*
+** }=============================================================
+*/
+
+
 /* luaH_new()函数用于创建一个新的lua表 */
 Table *luaH_new (lua_State *L) {
   GCObject *o = luaC_newobj(L, LUA_TTABLE, sizeof(Table));
   Table *t = gco2t(o);
   t->metatable = NULL;
-  t->flags = cast_byte(~0);
+  t->flags = cast_byte(~(1u << WATCHBIT));  /* no TMs, not watched */
   t->array = NULL;
   t->sizearray = 0;
+  t->lenhint = 0;
+  t->nextpos = 0;
+  t->ntrav = 0;
+  t->atype = 0;
+  t->old = NULL;
+  t->shape = NULL;
+  t->svals = NULL;
   setnodevector(L, t, 0);
   return t;
 }
@@ -596,13 +2010,34 @@ Table *luaH_new (lua_State *L) {
 ** 以及散列表部分中散列数组的内存，最后释放lua表本身占用的内存。
 */
 void luaH_free (lua_State *L, Table *t) {
+  luaH_checkwatch(L, t);  /* caches may point to it */
   if (!isdummy(t))
-    luaM_freearray(L, t->node, cast(size_t, sizenode(t)));
-  luaM_freearray(L, t->array, t->sizearray);
+    luaM_freearray(L, t->node, nodevecsize(cast(size_t, sizenode(t))));
+  else if (isshaped(t))  /* shapes are swept only after all tables */
+    luaM_freearray(L, t->svals, shapecap(t->shape->nkeys));
+  if (istyped(t))
+    luaM_freemem(L, t->array, arraybytes(t));
+  else
+    luaM_freearray(L, t->array, t->sizearray);
+  if (t->old != NULL)
+    freeold(L, t->old);
   luaM_free(L, t);
 }
 
 
+/*
+** 被监视的表't'将要改变：递增全局的方法缓存版本号，使所有已填入的方法缓存
+** 失效。此后没有缓存再引用't'，所以同时取消对它的监视。
+*/
+void luaH_unwatch (lua_State *L, Table *t) {
+  if (isfrozen(t))
+    frozenerror(L);
+  t->flags &= cast_byte(~(1u << WATCHBIT));
+  G(L)->mcepoch++;
+}
+
+
+#if !defined(LUA_SWISSTABLE)
 /* getfreepos()会从后往前遍历散列数组，找到一个key信息为空的Node节点，然后返回 */
 static Node *getfreepos (Table *t) {
   if (!isdummy(t)) {
@@ -614,6 +2049,7 @@ static Node *getfreepos (Table *t) {
   }
   return NULL;  /* could not find a free place */
 }
+#endif
 
 
 
@@ -628,7 +2064,7 @@ static Node *getfreepos (Table *t) {
 ** 为key对象分配一个新的Node节点，并将key作为该Node节点的key信息，
 ** 然后返回该Node节点的value对象的指针
 */
-TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
+static TValue *newkey (lua_State *L, Table *t, const TValue *key) {
   Node *mp;
   TValue aux;
 
@@ -649,7 +2085,27 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
     else if (luai_numisnan(fltvalue(key)))
       luaG_runerror(L, "table index is NaN");
   }
+  lua_assert(!istyped(t) || !ttisinteger(key) ||
+             l_castS2U(ivalue(key)) - 1 >= typedarray(t)->size);
 
+  /*
+  ** 散列部分为空或处于形状模式时，短字符串key只需要换一个形状；其他key（或者
+  ** 形状已满）走下面的普通流程，由于't'使用dummynode，必然通过'rehash'
+  ** 转换成Node数组。
+  */
+  if (ttisshrstring(key) && isdummy(t) &&
+      (!isshaped(t) || t->shape->nkeys < MAXSHAPEKEYS))
+    return shapenewkey(L, t, tsvalue(key));
+
+#if defined(LUA_SWISSTABLE)
+  /* 没有可用的空槽（包括dummynode）就rehash，否则占用探测序列上的第一个空槽 */
+  if (t->growthleft == 0) {
+    rehash(L, t, key);  /* grow table */
+    /* whatever called 'newkey' takes care of TM cache */
+    return luaH_set(L, t, key);  /* insert key into grown table */
+  }
+  mp = getfreepos(t, hashkey(key));
+#else
   /*
   ** 根据key对象找出该key所落在的mainposition，并返回所在的
   ** mainposition中的第一个Node节点。
@@ -719,12 +2175,35 @@ TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
       mp = f;
     }
   }
+#endif
 
 	/* 将key对象作为Node节点的key信息，然后返回Node的value指针 */
   setnodekey(L, &mp->i_key, key);
   luaC_barrierback(L, t, key);
-  lua_assert(ttisnil(gval(mp)));
-  return gval(mp);
+  lua_assert(ttisnil(nval(t, mp)));
+  return nval(t, mp);
+}
+
+
+/*
+** inserts a new key into a table; while the hash part is being resized
+** incrementally, each new key first moves some old nodes. A new key
+** ends any traversal of the table (see 'starttrav'). A table that the
+** collector found mostly empty, but could not shrink, is shrunk first
+** (see 'luaH_shrink'). A substring view gets its own contents before
+** becoming a key, so that keys never keep other strings alive.
+*/
+TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key) {
+  if (isfrozen(t))
+    frozenerror(L);
+  t->ntrav = 0;
+  if (testbit(t->marked, SHRINKBIT))  /* collector found it mostly empty? */
+    luaH_shrink(L, t, key);
+  if (ttislngstring(key) && issub(tsvalue(key)))
+    luaS_flat(L, tsvalue(key));
+  if (t->old != NULL)
+    moveold(L, t);
+  return newkey(L, t, key);
 }
 
 
@@ -741,6 +2220,18 @@ const TValue *luaH_getint (Table *t, lua_Integer key) {
   /* (1 <= key && key <= t->sizearray) */
   if (l_castS2U(key) - 1 < t->sizearray)
     return &t->array[key - 1];
+  else if (istyped(t) && l_castS2U(key) - 1 < typedarray(t)->size)
+    return gettyped(t, cast(unsigned int, key - 1));
+#if defined(LUA_SWISSTABLE)
+  else {
+    unsigned int h = inthash(key);
+    probe(t, h, n,
+      if (ttisinteger(gkey(n)) && ivalue(gkey(n)) == key)
+        return nval(t, n);  /* that's it */
+    )
+    return getold(t, luaH_getint(t->old, key));
+  }
+#else
   else {
     Node *n = hashint(t, key);
     for (;;) {  /* check whether 'key' is somewhere in the chain */
@@ -753,23 +2244,93 @@ const TValue *luaH_getint (Table *t, lua_Integer key) {
         n += nx;
       }
     }
-    return luaO_nilobject;
+    return getold(t, luaH_getint(t->old, key));
   }
+#endif
+}
+
+
+/*
+** 'luaH_getshortstrhint' for a key missing from the new hash part of 't'.
+** A key found in the old hash part has no node of 't' to be remembered.
+*/
+static const TValue *oldshortstr (Table *t, TString *key, int *hint) {
+  const TValue *v = getold(t, luaH_getshortstr(t->old, key));
+  if (v != luaO_nilobject)
+    *hint = -1;  /* never matches */
+  return v;
 }
 
 
 /*
 ** search function for short strings
 */
+#if defined(LUA_SWISSTABLE)
+
+/* index of short string 'key' in the hash part of 't' (-1 if absent) */
+static int shortstrslot (Table *t, TString *key) {
+  unsigned int h = mixhash(key->hash);
+  probe(t, h, n,
+    const TValue *k = gkey(n);
+    if (ttisshrstring(k) && eqshrstr(tsvalue(k), key))
+      return cast_int(n - gnode(t, 0));
+  )
+  return -1;
+}
+
+
+const TValue *luaH_getshortstr (Table *t, TString *key) {
+  int i;
+  lua_assert(key->tt == LUA_TSHRSTR);
+  if (isshaped(t)) {  /* 形状模式：在形状中找到槽位 */
+    i = shapeslot(t->shape, key);
+    return (i < 0) ? luaO_nilobject : &t->svals[i];
+  }
+  i = shortstrslot(t, key);
+  return (i < 0) ? getold(t, luaH_getshortstr(t->old, key)) : &t->hvals[i];
+}
+
+
+const TValue *luaH_getshortstrhint (Table *t, TString *key, int *hint) {
+  int i;
+  lua_assert(key->tt == LUA_TSHRSTR);
+  if (isshaped(t))  /* the hint is the slot in the shape */
+    i = shapeslot(t->shape, key);
+  else
+    i = shortstrslot(t, key);
+  if (i < 0)
+    return oldshortstr(t, key, hint);  /* not found (in the new part) */
+  *hint = i;  /* remember where it is */
+  return isshaped(t) ? &t->svals[i] : &t->hvals[i];
+}
+
+
+static const TValue *getgeneric (Table *t, const TValue *key) {
+  unsigned int h = hashkey(key);
+  probe(t, h, n,
+    /* the whole hash is at hand: avoid comparing long strings */
+    if (nodehash(n) == h && luaV_rawequalobj(gkey(n), key))
+      return nval(t, n);  /* that's it */
+  )
+  return getold(t, getgeneric(t->old, key));
+}
+
+#else
+
 /* 从lua表中获取键值为短字符串类型的value信息 */
 const TValue *luaH_getshortstr (Table *t, TString *key) {
+  Node *n;
+  lua_assert(key->tt == LUA_TSHRSTR);
+  if (isshaped(t)) {  /* 形状模式：在形状中找到槽位 */
+    int i = shapeslot(t->shape, key);
+    return (i < 0) ? luaO_nilobject : &t->svals[i];
+  }
 
   /*
   ** 根据字符串的hash值从lua表的散列表部分获取所在的
   ** mainposition中的首个Node节点
   */
-  Node *n = hashstr(t, key);
-  lua_assert(key->tt == LUA_TSHRSTR);
+  n = hashstr(t, key);
 
   /*
   ** 遍历mainposition中所有的Node节点，找到键值等于参数指定的key的Node节点，
@@ -782,8 +2343,40 @@ const TValue *luaH_getshortstr (Table *t, TString *key) {
       return gval(n);  /* that's it */
     else {
       int nx = gnext(n);
-      if (nx == 0)
-        return luaO_nilobject;  /* not found */
+      if (nx == 0)  /* not found (in the new hash part)? */
+        return getold(t, luaH_getshortstr(t->old, key));
+      n += nx;
+    }
+  }
+}
+
+
+/*
+** same as 'luaH_getshortstr', but records in '*hint' the index of the
+** node where 'key' was found, so that the next lookup from the same
+** instruction can go straight to it (see 'luaH_getshortstrh')
+*/
+const TValue *luaH_getshortstrhint (Table *t, TString *key, int *hint) {
+  Node *n;
+  lua_assert(key->tt == LUA_TSHRSTR);
+  if (isshaped(t)) {  /* the hint is the slot in the shape */
+    int i = shapeslot(t->shape, key);
+    if (i < 0)
+      return luaO_nilobject;  /* not found */
+    *hint = i;
+    return &t->svals[i];
+  }
+  n = hashstr(t, key);
+  for (;;) {  /* check whether 'key' is somewhere in the chain */
+    const TValue *k = gkey(n);
+    if (ttisshrstring(k) && eqshrstr(tsvalue(k), key)) {
+      *hint = cast_int(n - gnode(t, 0));  /* remember where it is */
+      return gval(n);  /* that's it */
+    }
+    else {
+      int nx = gnext(n);
+      if (nx == 0)  /* not found (in the new hash part)? */
+        return oldshortstr(t, key, hint);
       n += nx;
     }
   }
@@ -802,13 +2395,15 @@ static const TValue *getgeneric (Table *t, const TValue *key) {
       return gval(n);  /* that's it */
     else {
       int nx = gnext(n);
-      if (nx == 0)
-        return luaO_nilobject;  /* not found */
+      if (nx == 0)  /* not found (in the new hash part)? */
+        return getold(t, getgeneric(t->old, key));
       n += nx;
     }
   }
 }
 
+#endif
+
 
 /* 根据字符串类型的key从lua表中获取对应的value对象 */
 const TValue *luaH_getstr (Table *t, TString *key) {
@@ -858,7 +2453,15 @@ const TValue *luaH_get (Table *t, const TValue *key) {
 ** 上层调用者可以在这个指针指向的内存处存放value信息
 */
 TValue *luaH_set (lua_State *L, Table *t, const TValue *key) {
-  const TValue *p = luaH_get(t, key);
+  const TValue *p;
+  lua_Integer k;
+  if (isfrozen(t))
+    frozenerror(L);
+  if (istyped(t) && getintkey(key, &k) &&
+      l_castS2U(k) - 1 < typedarray(t)->size)
+    boxarray(L, t);  /* caller will store anything through the result */
+  p = luaH_get(t, key);
+  lua_assert(!istyped(t) || p != &typedarray(t)->v);
   if (p != luaO_nilobject)
     return cast(TValue *, p);
   else return luaH_newkey(L, t, key);
@@ -873,8 +2476,14 @@ TValue *luaH_set (lua_State *L, Table *t, const TValue *key) {
 ** Node节点的value对象即为参数指定的value对象。
 */
 void luaH_setint (lua_State *L, Table *t, lua_Integer key, TValue *value) {
-  const TValue *p = luaH_getint(t, key);
+  const TValue *p;
   TValue *cell;
+  if (isfrozen(t))
+    frozenerror(L);
+  if (istyped(t) && settyped(L, t, key, value))
+    return;
+  p = luaH_getint(t, key);
+  lua_assert(!istyped(t) || p != &typedarray(t)->v);
   if (p != luaO_nilobject)
     cell = cast(TValue *, p);
   else {
@@ -888,6 +2497,7 @@ void luaH_setint (lua_State *L, Table *t, lua_Integer key, TValue *value) {
 
   /* 将参数指定的value对象设置为key对应的value对象 */
   setobj2t(L, cell, value);
+  luaH_checkfull(L, t, cell);
 }
 
 
@@ -925,17 +2535,50 @@ static lua_Unsigned unbound_search (Table *t, lua_Unsigned j) {
 ** 否则前面的数组部分查不到满足条件的数据，则进入散列表部分查找：
 ** 在散列表部分二分查找返回位置i ，其中i是满足条件t[i] ! = nil 且t[i + 1] = nil 的最大值。
 */
+/*
+** 'i' (< sizearray) is a border in the array part: t[i] is non-nil (or
+** 'i' is 0) and t[i + 1] is nil
+*/
+#define isborder(t,i) \
+  (((i) == 0 || !ttisnil(&(t)->array[(i) - 1])) && ttisnil(&(t)->array[i]))
+
+
 lua_Unsigned luaH_getn (Table *t) {
   unsigned int j = t->sizearray;
-  if (j > 0 && ttisnil(&t->array[j - 1])) {
-    /* there is a boundary in the array part: (binary) search for it */
+  if (istyped(t)) {  /* keys 1..n present, n + 1 absent if inside */
+    unsigned int n = typedarray(t)->n;
+    if (n < typedarray(t)->size || isdummy(t))
+      return n;
+    else return unbound_search(t, n);
+  }
+  else if (j > 0 && ttisnil(&t->array[j - 1])) {
+    /*
+    ** there is a boundary in the array part. Try first the one found
+    ** last time and its neighbors (after an append or a removal at the
+    ** end of a sequence); otherwise (binary) search for it, using the
+    ** hint to halve the interval, and remember the result.
+    */
+    unsigned int h = t->lenhint;
     unsigned int i = 0;
+    lua_assert(h <= j);
+    if (h < j) {
+      if (isborder(t, h))
+        return h;
+      else if (h + 1 < j && isborder(t, h + 1))
+        return t->lenhint = h + 1;
+      else if (h > 0 && isborder(t, h - 1))
+        return t->lenhint = h - 1;
+      else if (h == 0 || !ttisnil(&t->array[h - 1]))
+        i = h;  /* t[h] is present: a border is in [h, j) */
+      else
+        j = h;  /* t[h] is absent: a border is in [0, h) */
+    }
     while (j - i > 1) {
       unsigned int m = (i+j)/2;
       if (ttisnil(&t->array[m - 1])) j = m;
       else i = m;
     }
-    return i;
+    return t->lenhint = i;
   }
   /* else must find a boundary in hash part */
   else if (isdummy(t))  /* hash part is empty? */
@@ -948,7 +2591,13 @@ lua_Unsigned luaH_getn (Table *t) {
 #if defined(LUA_DEBUG)
 
 Node *luaH_mainposition (const Table *t, const TValue *key) {
+#if defined(LUA_SWISSTABLE)
+  /* first slot of the first group probed for 'key' */
+  unsigned int g = (hashkey(key) >> 7) & (numgroups(t) - 1);
+  return gnode(t, g * GROUPSIZE);
+#else
   return mainposition(t, key);
+#endif
 }
 
 int luaH_isdummy (const Table *t) { return isdummy(t); }
@@ -13,8 +13,15 @@
 /* gnode用于从table中获取由i索引的Node节点 */
 #define gnode(t,i)	(&(t)->node[i])
 
+#if defined(LUA_SWISSTABLE)
+/* values live apart from the keys: 'nval' gives the one of node 'n' */
+#define nval(t,n)	(&(t)->hvals[(n) - (t)->node])
+#else
 /* gval用于获取Node节点中的value信息 */
 #define gval(n)		(&(n)->i_val)
+/* value of node 'n' of table 't' (same as 'gval', valid in both layouts) */
+#define nval(t,n)	((void)(t), gval(n))
+#endif
 
 /* gnext用于获取同一个mainposition中的下一个Node节点对应的索引 */
 #define gnext(n)	((n)->i_key.nk.next)
@@ -33,25 +40,188 @@
 //让Table的快速查找元方法的cache失效
 #define invalidateTMcache(t)	((t)->flags = 0)
 
+/*
+** 'flags'的第7位（元方法cache只用到TM_EQ及之前的位）：表在某个OP_SELF方法
+** 缓存的'__index'链上。这样的表被写入字符串key、更换元表或者被释放时，
+** 需要通过luaH_unwatch让所有方法缓存失效。
+*/
+#define WATCHBIT	7
+#define iswatched(t)	((t)->flags & (1u << WATCHBIT))
+#define luaH_watch(t) \
+	(iswatched(t) ? (void)0 : (void)((t)->flags |= cast_byte(1u << WATCHBIT)))
+
+#define luaH_checkwatch(L,t)	(iswatched(t) ? luaH_unwatch(L, t) : (void)0)
+
+
+#if defined(LUA_SWISSTABLE)
+
+/* number of slots whose control bytes are compared at once */
+#define GROUPSIZE	16
+
+/* control bytes for 'n' slots: at least a whole group */
+#define ctrlsize(n)	((n) < GROUPSIZE ? GROUPSIZE : (n))
+
+/*
+** number of 'Node's allocated for a hash part with 'n' slots; the values
+** and then the control bytes live right after the keys, in the same block
+*/
+#define nodevecsize(n) ((n) == 0 ? 0 : \
+	(n) + ((n) * sizeof(TValue) + ctrlsize(n) + sizeof(Node) - 1) / sizeof(Node))
+
+/* control bytes of 'dummynode': one group of empty slots */
+LUAI_DDEC const lu_byte luaH_emptyctrl_[GROUPSIZE];
+
+/* true when 't' is using 'dummynode' as its hash part */
+#define isdummy(t)		((t)->ctrl == luaH_emptyctrl_)
+
+#else
+
+#define nodevecsize(n)	(n)
 
 /* true when 't' is using 'dummynode' as its hash part */
 #define isdummy(t)		((t)->lastfree == NULL)
 
+#endif
+
+
+/*
+** 类型化数组部分：元素全是整数（或全是浮点数）并且没有空洞的数组部分，只存放
+** 数值本身。'array'指向这个头部，元素紧跟在它后面；表的'sizearray'为0，所以
+** 不了解类型化数组的代码（GC遍历、数组部分的快速路径）会自然地跳过它。读元素
+** 时把它复制到'v'并返回'v'的地址，通过这个地址写入后要用'luaH_checktyped'
+** 写回。
+*/
+typedef struct TypedArray {
+  TValue v;  /* copy of the element read last */
+  unsigned int i;  /* index (0-based) of that element */
+  unsigned int n;  /* number of elements (keys 1..n are present) */
+  unsigned int size;  /* capacity (keys up to 'size' belong to the array) */
+} TypedArray;
+
+#if defined(LUA_TYPEDARRAY)
+#define istyped(t)	((t)->atype != 0)
+#else
+#define istyped(t)	((void)(t), 0)  /* (arrays are never typed) */
+#endif
+#define typedarray(t)	cast(TypedArray *, (t)->array)
+
+/* bytes used by a typed array of type 'tt' with capacity 'n' */
+#define typedsize(tt,n)	(sizeof(TypedArray) + cast(size_t, n) * \
+	((tt) == LUA_TNUMINT ? sizeof(lua_Integer) : sizeof(lua_Number)))
+
+/* bytes used by the array part of 't' */
+#define arraybytes(t)	(istyped(t) ? \
+	typedsize((t)->atype, typedarray(t)->size) : \
+	sizeof(TValue) * cast(size_t, (t)->sizearray))
+
+/*
+** a raw store through 'slot' of 't' has just been done; if 'slot' was the
+** copy of an element of a typed array part, store it back
+*/
+#define luaH_checktyped(L,t,slot) \
+	(istyped(t) && (slot) == (t)->array ? luaH_committyped(L, t) : (void)0)
+
+/*
+** a raw store has just filled 'slot' of 't'; if it is the last slot of
+** a large enough array part, try to turn that part into a typed array
+** (only once for each size of the array part)
+*/
+#if defined(LUA_TYPEDARRAY)
+#define luaH_checkfull(L,t,slot) \
+	((t)->sizearray >= LUAI_MINTYPED && \
+	 (slot) == &(t)->array[(t)->sizearray - 1] && \
+	 !testbit((t)->marked, NOTYPEBIT) ? luaH_trytype(L, t) : (void)0)
+#else
+#define luaH_checkfull(L,t,slot)	((void)0)
+#endif
+
+
+/*
+** true when the hash part of 't' is a shape plus the value array 'svals'
+** (such a table also uses 'dummynode', so 'isdummy' holds for it)
+*/
+#define isshaped(t)		((t)->shape != NULL)
+
+/* 形状模式下'svals'的容量：不小于'n'的最小的2的整数次幂 */
+#define shapecap(n)	((n) == 0 ? 0 : twoto(luaO_ceillog2(n)))
+
 
 /* allocated size for hash nodes */
 /* 获取lua表中散列表部分的散列数组的大小 */
 #define allocsizenode(t)	(isdummy(t) ? 0 : sizenode(t))
 
 
-/* returns the key, given the value of a table entry */
-#define keyfromval(v) \
-  (gkey(cast(Node *, cast(char *, (v)) - offsetof(Node, i_val))))
+/*
+** 检查槽位提示'h'：若'h'仍在散列数组范围内，并且该Node的key正是短字符串
+** 'key'，那么这就是'key'所在的节点。提示只是一个下标，表resize之后或者key被
+** 删除后（变为deadkey）校验自然失败，因此不需要显式的失效处理。
+** 形状模式下提示是Shape中的槽位下标，校验方式相同。
+*/
+#define luaH_hintmatch(t,key,h) \
+  (isshaped(t) ? \
+     (cast(unsigned int, h) < (t)->shape->nkeys && \
+      (t)->shape->keys[h] == (key)) : \
+     (cast(unsigned int, h) < cast(unsigned int, sizenode(t)) && \
+      checktag(gkey(gnode(t, h)), ctb(LUA_TSHRSTR)) && \
+      tsvalue(gkey(gnode(t, h))) == (key)))
+
+/* 已经通过'luaH_hintmatch'校验的提示'h'所对应的value */
+#define luaH_hintval(t,h) \
+  (isshaped(t) ? cast(const TValue *, &(t)->svals[h]) : \
+                 cast(const TValue *, nval(t, gnode(t, h))))
+
+/*
+** 带槽位提示的短字符串查找：提示命中时只需一次比较和一次读取，
+** 否则走'luaH_getshortstrhint'并更新提示
+*/
+#define luaH_getshortstrh(t,key,hint) \
+  (luaH_hintmatch(t, key, *(hint)) ? luaH_hintval(t, *(hint)) : \
+     luaH_getshortstrhint(t, key, hint))
+
+
+/*
+** 冻结表映像：'lua_freeze'把一棵表树（表、字符串和其他不可回收的值）变成
+** 只读的，并从冻结它的状态的GC堆中取出。映像中的对象带FROZENBIT，没有颜色，
+** 不在任何GC链表上，所以任何状态的GC都不会标记、遍历或回收它们；映像由引用
+** 计数管理，计数为0时用冻结它的状态的分配函数释放。冻结的表总是带WATCHBIT，
+** 写入时经由'luaH_unwatch'报错，也不会再写自己的任何字段，因此可以被运行在
+** 不同线程中的多个状态同时读取（见ltable.c中的"Frozen tables"）。从文件装入的
+** 映像（见'luaU_loadimage'）的所有对象都在'map'中，'objs'为空，释放时整块交给
+** 'release'。
+*/
+struct lua_Frozen {
+  Table *root;  /* the table given to 'lua_freeze' */
+  GCObject *objs;  /* objects of the image, linked by 'next' */
+  TString **strs;  /* its short strings, by hash (open addressing) */
+  struct lua_Frozen **deps;  /* images with objects used by this one */
+  lua_Alloc frealloc;  /* allocation function of the state that made it */
+  void *ud;  /* auxiliary data to 'frealloc' */
+  unsigned int seed;  /* hash seed of the state that made it */
+  int sizestrs;  /* size of 'strs' (a power of 2, or 0) */
+  int ndeps;  /* number of elements in 'deps' */
+  int nref;  /* states using the image plus references held by the host */
+  void *map;  /* block with all objects of a loaded image, or NULL */
+  size_t sizemap;  /* size of 'map' */
+  lua_Alloc release;  /* frees 'map' (called with a new size of 0) */
+  void *releaseud;  /* auxiliary data to 'release' */
+};
+
+
+/* returns the key, given the value of an entry of 't' (not for shapes) */
+#if defined(LUA_SWISSTABLE)
+#define keyfromval(t,v)	(gkey(gnode(t, (v) - (t)->hvals)))
+#else
+#define keyfromval(t,v) \
+  ((void)(t), gkey(cast(Node *, cast(char *, (v)) - offsetof(Node, i_val))))
+#endif
 
 
 LUAI_FUNC const TValue *luaH_getint (Table *t, lua_Integer key);
 LUAI_FUNC void luaH_setint (lua_State *L, Table *t, lua_Integer key,
                                                     TValue *value);
 LUAI_FUNC const TValue *luaH_getshortstr (Table *t, TString *key);
+LUAI_FUNC const TValue *luaH_getshortstrhint (Table *t, TString *key,
+                                              int *hint);
 LUAI_FUNC const TValue *luaH_getstr (Table *t, TString *key);
 LUAI_FUNC const TValue *luaH_get (Table *t, const TValue *key);
 LUAI_FUNC TValue *luaH_newkey (lua_State *L, Table *t, const TValue *key);
@@ -60,9 +230,21 @@ LUAI_FUNC Table *luaH_new (lua_State *L);
 LUAI_FUNC void luaH_resize (lua_State *L, Table *t, unsigned int nasize,
                                                     unsigned int nhsize);
 LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, unsigned int nasize);
+LUAI_FUNC void luaH_shrink (lua_State *L, Table *t, const TValue *ek);
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
+LUAI_FUNC void luaH_unwatch (lua_State *L, Table *t);
 LUAI_FUNC int luaH_next (lua_State *L, Table *t, StkId key);
 LUAI_FUNC lua_Unsigned luaH_getn (Table *t);
+LUAI_FUNC void luaH_committyped (lua_State *L, Table *t);
+LUAI_FUNC const TValue *luaH_typedset (lua_State *L, Table *t,
+                                       const TValue *key, const TValue *val);
+LUAI_FUNC void luaH_trytype (lua_State *L, Table *t);
+LUAI_FUNC lua_Frozen *luaH_freeze (lua_State *L, Table *t);
+LUAI_FUNC void luaH_attach (lua_State *L, lua_Frozen *f);
+LUAI_FUNC void luaH_release (lua_Frozen *f);
+LUAI_FUNC void luaH_releaseimages (lua_State *L);
+LUAI_FUNC void luaH_resizeshapes (lua_State *L, int newsize);
+LUAI_FUNC void luaH_freeshapes (lua_State *L);
 
 
 #if defined(LUA_DEBUG)
@@ -420,6 +420,46 @@ static int sort (lua_State *L) {
   return 0;
 }
 
+
+/*
+** 冻结表't'及它能到达的所有表，之后对它们的任何修改都会报错。返回't'。
+*/
+static int tfreeze (lua_State *L) {
+  lua_Frozen *f;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  f = lua_freeze(L, 1);
+  if (f != NULL)  /* the state keeps its own reference */
+    lua_releasefrozen(f);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int writer (lua_State *L, const void *b, size_t size, void *B) {
+  (void)L;
+  luaL_addlstring((luaL_Buffer *) B, (const char *)b, size);
+  return 0;
+}
+
+
+/*
+** 冻结表't'（同'table.freeze'），返回它的表映像：一个可以写入文件、
+** 再由宿主程序在新建的状态中用'luaL_loadimage'映射使用的字符串。
+** 没有对应的Lua函数来装入映像：映像要用装入它的状态的散列种子，通常是
+** 刚创建的状态在装入时采用映像的种子（见'luaL_loadimage'）。
+*/
+static int tdumpimage (lua_State *L) {
+  luaL_Buffer b;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_settop(L, 1);
+  luaL_buffinit(L, &b);
+  if (lua_dumpimage(L, writer, &b) != 0)
+    return luaL_error(L, "unable to dump given table");
+  luaL_pushresult(&b);
+  return 1;
+}
+
+
 /* }====================================================== */
 
 
@@ -434,6 +474,8 @@ static const luaL_Reg tab_funcs[] = {
   {"remove", tremove},
   {"move", tmove},
   {"sort", sort},
+  {"freeze", tfreeze},
+  {"dumpimage", tdumpimage},
   {NULL, NULL}
 };
 
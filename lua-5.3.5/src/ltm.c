@@ -101,8 +101,10 @@ const char *luaT_objtypename (lua_State *L, const TValue *o) {
   if ((ttistable(o) && (mt = hvalue(o)->metatable) != NULL) ||
       (ttisfulluserdata(o) && (mt = uvalue(o)->metatable) != NULL)) {
     const TValue *name = luaH_getshortstr(mt, luaS_new(L, "__name"));
-    if (ttisstring(name))  /* is '__name' a string? */
+    if (ttisstring(name)) {  /* is '__name' a string? */
+      luaS_flat(L, tsvalue(name));
       return getstr(tsvalue(name));  /* use it as type name */
+    }
   }
   return ttypename(ttnov(o));  /* else use standard type name */
 }
@@ -153,7 +155,12 @@ int luaT_callbinTM (lua_State *L, const TValue *p1, const TValue *p2,
 //res为输出，p1和p2为输入，event为运算指令
 void luaT_trybinTM (lua_State *L, const TValue *p1, const TValue *p2,
                     StkId res, TMS event) {
-  if (!luaT_callbinTM(L, p1, p2, res, event)) {
+  if (event != TM_CONCAT && (islazyvalue(p1) || islazyvalue(p2))) {
+    /* operand may be a numeral in a rope; flatten it and try again */
+    luaS_flatvalue(L, p1); luaS_flatvalue(L, p2);
+    luaO_arith(L, cast_int(event - TM_ADD) + LUA_OPADD, p1, p2, res);
+  }
+  else if (!luaT_callbinTM(L, p1, p2, res, event)) {
     //接下来错误处理
     switch (event) {
       case TM_CONCAT:
@@ -73,6 +73,12 @@
 
 typedef struct lua_State lua_State;
 
+/* an immutable table tree that states can share (see 'lua_freeze') */
+typedef struct lua_Frozen lua_Frozen;
+
+/* pinned string used as a key without looking it up (see 'lua_newhandle') */
+typedef struct lua_Handle lua_Handle;
+
 
 /*
 ** basic types
@@ -262,6 +268,10 @@ LUA_API void        (lua_pushnumber) (lua_State *L, lua_Number n);
 LUA_API void        (lua_pushinteger) (lua_State *L, lua_Integer n);
 LUA_API const char *(lua_pushlstring) (lua_State *L, const char *s, size_t len);
 LUA_API const char *(lua_pushstring) (lua_State *L, const char *s);
+LUA_API void        (lua_pushsubstring) (lua_State *L, int idx, size_t off,
+                                                        size_t len);
+LUA_API lua_Handle *(lua_newhandle) (lua_State *L, const char *s);
+LUA_API const char *(lua_pushhandle) (lua_State *L, lua_Handle *h);
 LUA_API const char *(lua_pushvfstring) (lua_State *L, const char *fmt,
                                                       va_list argp);
 LUA_API const char *(lua_pushfstring) (lua_State *L, const char *fmt, ...);
@@ -277,6 +287,7 @@ LUA_API int   (lua_pushthread) (lua_State *L);
 LUA_API int (lua_getglobal) (lua_State *L, const char *name);
 LUA_API int (lua_gettable) (lua_State *L, int idx);
 LUA_API int (lua_getfield) (lua_State *L, int idx, const char *k);
+LUA_API int (lua_getfield_h) (lua_State *L, int idx, lua_Handle *k);
 LUA_API int (lua_geti) (lua_State *L, int idx, lua_Integer n);
 LUA_API int (lua_rawget) (lua_State *L, int idx);
 LUA_API int (lua_rawgeti) (lua_State *L, int idx, lua_Integer n);
@@ -294,6 +305,7 @@ LUA_API int  (lua_getuservalue) (lua_State *L, int idx);
 LUA_API void  (lua_setglobal) (lua_State *L, const char *name);
 LUA_API void  (lua_settable) (lua_State *L, int idx);
 LUA_API void  (lua_setfield) (lua_State *L, int idx, const char *k);
+LUA_API void  (lua_setfield_h) (lua_State *L, int idx, lua_Handle *k);
 LUA_API void  (lua_seti) (lua_State *L, int idx, lua_Integer n);
 LUA_API void  (lua_rawset) (lua_State *L, int idx);
 LUA_API void  (lua_rawseti) (lua_State *L, int idx, lua_Integer n);
@@ -362,6 +374,8 @@ LUA_API int (lua_gc) (lua_State *L, int what, int data);
 LUA_API int   (lua_error) (lua_State *L);
 
 LUA_API int   (lua_next) (lua_State *L, int idx);
+LUA_API void  (lua_setiterators) (lua_State *L, lua_CFunction next,
+                                  lua_CFunction inext);
 
 LUA_API void  (lua_concat) (lua_State *L, int n);
 LUA_API void  (lua_len)    (lua_State *L, int idx);
@@ -372,6 +386,20 @@ LUA_API lua_Alloc (lua_getallocf) (lua_State *L, void **ud);
 LUA_API void      (lua_setallocf) (lua_State *L, lua_Alloc f, void *ud);
 
 
+/*
+** frozen tables
+*/
+
+LUA_API lua_Frozen *(lua_freeze) (lua_State *L, int idx);
+LUA_API void  (lua_pushfrozen) (lua_State *L, lua_Frozen *f);
+LUA_API void  (lua_releasefrozen) (lua_Frozen *f);
+LUA_API lua_Frozen *(lua_poolstrings) (lua_State *L);
+LUA_API int   (lua_dumpimage) (lua_State *L, lua_Writer writer, void *data);
+LUA_API lua_Frozen *(lua_loadimage) (lua_State *L, void *p, size_t size,
+                                     lua_Alloc release, void *ud);
+LUA_API void *(lua_imagebase) (const void *p, size_t size);
+
+
 
 /*
 ** {==============================================================
@@ -31,6 +31,7 @@ static void PrintFunction(const Proto* f, int full);
 static int listing=0;			/* list bytecodes? */
 static int dumping=1;			/* dump bytecodes? */
 static int stripping=0;			/* strip debug information? */
+static const char* cmodule=NULL;	/* emit C source for this module? */
 static char Output[]={ OUTPUT };	/* default output file name */
 static const char* output=Output;	/* actual output file name */
 static const char* progname=PROGNAME;	/* actual program name */
@@ -56,6 +57,7 @@ static void usage(const char* message)
  fprintf(stderr,
   "usage: %s [options] [filenames]\n"
   "Available options are:\n"
+  "  -c name  output C source for module 'name' instead of a binary chunk\n"
   "  -l       list (use -l -l for full listing)\n"
   "  -o name  output to file 'name' (default is \"%s\")\n"
   "  -p       parse only\n"
@@ -86,6 +88,15 @@ static int doargs(int argc, char* argv[])
   }
   else if (IS("-"))			/* end of options; use stdin */
    break;
+  else if (IS("-c"))			/* C source for module */
+  {
+   const char* s;
+   cmodule=argv[++i];
+   if (cmodule==NULL || *cmodule==0) usage("'-c' needs argument");
+   for (s=cmodule; *s; s++)
+    if (!(isalnum((unsigned char)*s) || *s=='_' || *s=='.'))
+     usage("'-c' needs a module name");
+  }
   else if (IS("-l"))			/* list */
    ++listing;
   else if (IS("-o"))			/* output file */
@@ -162,6 +173,45 @@ static int writer(lua_State* L, const void* p, size_t size, void* u)
  return (fwrite(p,size,1,(FILE*)u)!=1) && (size!=0);
 }
 
+/*
+** 以C源码的形式输出预编译的chunk：字节码作为静态数组嵌入，
+** 再由luaopen_<模块名>加载并执行，这样预先知道的脚本可以直接链接进宿主
+** 程序或者编译成C模块通过require加载，省掉运行时的解析
+*/
+typedef struct {
+ FILE* D;			/* output file */
+ size_t n;			/* number of bytes written so far */
+} CState;
+
+static int cwriter(lua_State* L, const void* p, size_t size, void* u)
+{
+ CState* C=(CState*)u;
+ const unsigned char* b=(const unsigned char*)p;
+ UNUSED(L);
+ while (size--) fprintf(C->D,"%s%3u,",(C->n++%16==0) ? "\n " : "",*b++);
+ return ferror(C->D);
+}
+
+static void cdump(lua_State* L, const Proto* f, FILE* D)
+{
+ const char* s;
+ CState C;
+ C.D=D;
+ C.n=0;
+ fprintf(D,"/* generated by " PROGNAME " for module '%s' */\n\n",cmodule);
+ fprintf(D,"#include \"lua.h\"\n#include \"lauxlib.h\"\n\n");
+ fprintf(D,"static const unsigned char chunk[]={");
+ luaU_dump(L,f,cwriter,&C,stripping);
+ fprintf(D,"\n};\n\nLUAMOD_API int luaopen_");
+ for (s=cmodule; *s; s++) fputc((*s=='.') ? '_' : *s,D);
+ fprintf(D,"(lua_State* L)\n{\n"
+  " if (luaL_loadbufferx(L,(const char*)chunk,sizeof(chunk),\"=%s\",\"b\")!=LUA_OK)\n"
+  "  return lua_error(L);\n"
+  " lua_insert(L,1);\n"
+  " lua_call(L,lua_gettop(L)-1,1);\n"
+  " return 1;\n}\n",cmodule);
+}
+
 static int pmain(lua_State* L)
 {
  int argc=(int)lua_tointeger(L,1);
@@ -181,7 +231,10 @@ static int pmain(lua_State* L)
   FILE* D= (output==NULL) ? stdout : fopen(output,"wb");
   if (D==NULL) cannot("open");
   lua_lock(L);
-  luaU_dump(L,f,writer,D,stripping);
+  if (cmodule!=NULL)
+   cdump(L,f,D);
+  else
+   luaU_dump(L,f,writer,D,stripping);
   lua_unlock(L);
   if (ferror(D)) cannot("write");
   if (fclose(D)) cannot("close");
@@ -292,7 +345,7 @@ static void PrintCode(const Proto* f)
  for (pc=0; pc<n; pc++)
  {
   Instruction i=code[pc];
-  OpCode o=GET_OPCODE(i);
+  OpCode o=GET_BASEOP(i);
   int a=GETARG_A(i);
   int b=GETARG_B(i);
   int c=GETARG_C(i);
@@ -36,6 +36,28 @@
 /* #define LUA_32BITS */
 
 
+/*
+@@ LUA_SWISSTABLE makes the hash part of tables use open addressing
+** with one control byte per slot (a 7-bit tag of the key's hash, or a
+** mark for an empty slot) instead of chained scatter with Brent's
+** variation. Lookups compare a whole group of 16 control bytes at once
+** (with SSE2 when available) and only look at the keys whose tag
+** matches. It changes only the internals of 'ltable.c'.
+*/
+/* #define LUA_SWISSTABLE */
+
+
+/*
+@@ LUA_TYPEDARRAY lets a table whose array part is full of integers
+** (or full of floats) keep it as a packed vector of 'lua_Integer's (or
+** 'lua_Number's), without a tag per element. A large numeric array then
+** uses half the memory; each access to it costs a little more, and the
+** first store of a value of another type (or of a hole) turns the array
+** part back into 'TValue's. It changes only the internals of tables.
+*/
+/* #define LUA_TYPEDARRAY */
+
+
 /*
 @@ LUA_USE_C89 controls the use of non-ISO-C89 features.
 ** Define it if you want Lua to avoid the use of a few C99 features
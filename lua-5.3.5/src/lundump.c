@@ -19,7 +19,9 @@
 #include "lfunc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstring.h"
+#include "ltable.h"
 #include "lundump.h"
 #include "lzio.h"
 
@@ -109,6 +111,7 @@ static void LoadCode (LoadState *S, Proto *f) {
   f->code = luaM_newvector(S->L, n, Instruction);
   f->sizecode = n;
   LoadVector(S, f->code, n);
+  luaP_fuse(f->code, n);
 }
 
 
@@ -210,6 +213,7 @@ static void LoadFunction (LoadState *S, Proto *f, TString *psource) {
   f->maxstacksize = LoadByte(S);
   LoadCode(S, f);
   LoadConstants(S, f);
+  luaF_initslothints(S->L, f);
   LoadUpvalues(S, f);
   LoadProtos(S, f);
   LoadDebug(S, f);
@@ -277,3 +281,117 @@ LClosure *luaU_undump(lua_State *L, ZIO *Z, const char *name) {
   return cl;
 }
 
+
+/*
+** {======================================================
+** Table images
+** =======================================================
+*/
+
+static l_noret imageerror (lua_State *L, const char *why) {
+  luaO_pushfstring(L, "bad table image (%s)", why);
+  luaD_throw(L, LUA_ERRSYNTAX);
+}
+
+
+/*
+** Returns the header of the table image in the 'size' bytes at 'p'
+** (a copy of it in 'h'), or NULL if they do not start with an image
+** made by this build of Lua.
+*/
+static const ImageHeader *getheader (const void *p, size_t size,
+                                     ImageHeader *h) {
+  lu_byte layout[IMAGE_NLAYOUT];
+  if (size < sizeof(ImageHeader))
+    return NULL;
+  memcpy(h, p, sizeof(ImageHeader));
+  imagelayout(layout);
+  if (memcmp(h->signature, LUA_IMAGESIG, sizeof(LUA_IMAGESIG)) != 0 ||
+      memcmp(h->layout, layout, IMAGE_NLAYOUT) != 0 ||
+      h->luaint != LUAC_INT || h->luanum != LUAC_NUM)
+    return NULL;
+  return h;
+}
+
+
+/* address where the image at 'p' can be used without relocation */
+void *luaU_imagebase (const void *p, size_t size) {
+  ImageHeader h;
+  if (getheader(p, size, &h) == NULL)
+    return NULL;
+  return cast(void *, h.base);
+}
+
+
+static void attach (lua_State *L, void *ud) {
+  luaH_attach(L, cast(lua_Frozen *, ud));
+}
+
+
+/*
+** Uses in place the table image in the 'size' bytes at 'p' (see
+** 'luaU_dumpimage'). If the image is not at the address it was laid out
+** for, its pointers are relocated first, so 'p' must be writable. The
+** new image has a reference for the caller and one for the state; when
+** the last one is released, 'release' is called to free 'p' (with 'ud',
+** 'p', 'size' and 0). The image's strings become the strings of the
+** state with their contents (see 'luaS_adopt'). Like binary chunks,
+** images are trusted: only their header and relocations are checked.
+** On errors the caller still owns 'p'.
+*/
+lua_Frozen *luaU_loadimage (lua_State *L, void *p, size_t size,
+                            lua_Alloc release, void *ud) {
+  ImageHeader h;
+  char *b = cast(char *, p);
+  size_t delta;
+  lua_Frozen *f;
+  int status;
+  if (getheader(p, size, &h) == NULL)
+    imageerror(L, "not an image made by this Lua");
+  if (h.size > size || h.nrelocs > (size - h.size) / sizeof(size_t) ||
+      h.root > h.size - sizeof(Table) || h.strs > h.size ||
+      cast(size_t, h.sizestrs) > (h.size - h.strs) / sizeof(TString *))
+    imageerror(L, "truncated");
+  if (cast(size_t, b) % sizeof(L_Umaxalign) != 0)
+    imageerror(L, "misaligned");
+  delta = cast(size_t, b) - h.base;
+  if (delta != 0) {  /* not at its address? */
+    const char *r = b + h.size;
+    size_t i;
+    for (i = 0; i < h.nrelocs; i++) {
+      size_t at, ptr;
+      memcpy(&at, r + i * sizeof(size_t), sizeof(size_t));
+      if (at > h.size - sizeof(size_t))
+        imageerror(L, "bad relocation");
+      memcpy(&ptr, b + at, sizeof(size_t));
+      ptr += delta;
+      memcpy(b + at, &ptr, sizeof(size_t));
+    }
+    h.base = cast(size_t, b);
+    memcpy(b + offsetof(ImageHeader, base), &h.base, sizeof(size_t));
+  }
+  f = luaM_new(L, lua_Frozen);
+  f->root = cast(Table *, b + h.root);
+  f->objs = NULL;
+  f->strs = cast(TString **, b + h.strs);
+  f->deps = NULL;
+  f->frealloc = G(L)->frealloc;
+  f->ud = G(L)->ud;
+  f->seed = h.seed;
+  f->sizestrs = h.sizestrs;
+  f->ndeps = 0;
+  f->nref = 1;  /* the caller ('luaH_attach' adds the state) */
+  f->map = p;
+  f->sizemap = size;
+  f->release = release;
+  f->releaseud = ud;
+  status = luaD_rawrunprotected(L, attach, f);
+  if (status != LUA_OK) {
+    luaM_free(L, f);  /* but not 'p' */
+    luaD_throw(L, status);
+  }
+  G(L)->totalbytes -= sizeof(lua_Frozen);  /* not part of the state */
+  return f;
+}
+
+/* }====================================================== */
@@ -22,6 +22,46 @@
 #define LUAC_VERSION	(MYINT(LUA_VERSION_MAJOR)*16+MYINT(LUA_VERSION_MINOR))
 #define LUAC_FORMAT	0	/* this is the official format */
 
+/* signature of table images */
+#define LUA_IMAGESIG	"\x1bLuaImg"
+
+/* options of this build that change the memory layout of objects */
+#if defined(LUA_SWISSTABLE)
+#define IMAGE_SWISS	1
+#else
+#define IMAGE_SWISS	0
+#endif
+
+/* fills 'b' (IMAGE_NLAYOUT bytes) with what a table image depends on */
+#define IMAGE_NLAYOUT	8
+#define imagelayout(b) \
+  ((b)[0] = LUAC_VERSION, (b)[1] = sizeof(size_t), (b)[2] = sizeof(TValue), \
+   (b)[3] = sizeof(Node), (b)[4] = sizeof(Table), (b)[5] = sizeof(UTString), \
+   (b)[6] = LUAI_MAXSHORTLEN, (b)[7] = IMAGE_SWISS)
+
+
+/*
+** A table image is a frozen table tree laid out in a single block that
+** can be used in place (see 'luaU_dumpimage'). All offsets are from the
+** start of the image, where this header is. Pointers inside the image
+** are absolute, for address 'base'; the 'nrelocs' offsets of those
+** pointers (as 'size_t's) follow the image.
+*/
+typedef struct ImageHeader {
+  char signature[sizeof(LUA_IMAGESIG)];  /* LUA_IMAGESIG */
+  lu_byte layout[IMAGE_NLAYOUT];  /* see 'imagelayout' */
+  lua_Integer luaint;  /* LUAC_INT (checks the byte order) */
+  lua_Number luanum;  /* LUAC_NUM (checks the float format) */
+  size_t base;  /* address the image is laid out for */
+  size_t size;  /* size of the image (header included) */
+  size_t root;  /* offset of the root table */
+  size_t strs;  /* offset of the set of its short strings (see 'lua_Frozen') */
+  size_t nrelocs;  /* number of pointers to relocate */
+  unsigned int seed;  /* hash seed of its strings */
+  int sizestrs;  /* size of the set of short strings */
+} ImageHeader;
+
+
 /* load one chunk; from lundump.c */
 LUAI_FUNC LClosure* luaU_undump (lua_State* L, ZIO* Z, const char* name);
 
@@ -29,4 +69,13 @@ LUAI_FUNC LClosure* luaU_undump (lua_State* L, ZIO* Z, const char* name);
 LUAI_FUNC int luaU_dump (lua_State* L, const Proto* f, lua_Writer w,
                          void* data, int strip);
 
+/* dump a frozen table tree as an image; from ldump.c */
+LUAI_FUNC int luaU_dumpimage (lua_State *L, Table *t, lua_Writer w,
+                              void *data);
+
+/* use a table image; from lundump.c */
+LUAI_FUNC void *luaU_imagebase (const void *p, size_t size);
+LUAI_FUNC lua_Frozen *luaU_loadimage (lua_State *L, void *p, size_t size,
+                                      lua_Alloc release, void *ud);
+
 #endif
@@ -35,6 +35,19 @@
 #define MAXTAGLOOP	2000
 
 
+/*
+** By default, use jump tables in the main interpreter loop on gcc
+** and compatible compilers.
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#if defined(__GNUC__)
+#define LUA_USE_JUMPTABLE	1
+#else
+#define LUA_USE_JUMPTABLE	0
+#endif
+#endif
+
+
 
 /*
 ** 'l_intfitsf' checks whether a given integer can be converted to a
@@ -215,10 +228,19 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
       lua_assert(ttisnil(slot));  /* old value must be nil */
       tm = fasttm(L, h->metatable, TM_NEWINDEX);  /* get metamethod */
       if (tm == NULL) {  /* no metamethod? */
-        if (slot == luaO_nilobject)  /* no previous entry? */
-          slot = luaH_newkey(L, h, key);  /* create one */
-        /* no metamethod and (now) there is an entry with given key */
-        setobj2t(L, cast(TValue *, slot), val);  /* set its new value */
+        luaH_checkwatch(L, h);  /* before the store (may raise an error) */
+        if (istyped(h)) {  /* key may go to the typed array part */
+          slot = luaH_typedset(L, h, key, val);
+          lua_assert(slot == NULL || !istyped(h) ||
+                     slot != &typedarray(h)->v);  /* never the copy */
+        }
+        if (slot != NULL) {  /* not done yet? */
+          if (slot == luaO_nilobject)  /* no previous entry? */
+            slot = luaH_newkey(L, h, key);  /* create one */
+          /* no metamethod and (now) there is an entry with given key */
+          setobj2t(L, cast(TValue *, slot), val);  /* set its new value */
+          luaH_checkfull(L, h, slot);
+        }
         invalidateTMcache(h);
         //表内容的更改有可能导致 界畵畡 内其它对象的生命期变化，所以需要调用luaC_barrierback
         luaC_barrierback(L, h, val);
@@ -244,6 +266,80 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
 }
 
 
+/*
+** 沿着元表'mt'的'__index'链查找方法'key'，并把结果填入OP_SELF的方法缓存'mc'。
+** 只处理'__index'都是表的链；找到时返回方法所在的槽位，链上出现函数、
+** 找不到或者链过长时返回NULL，交给luaV_finishget按常规流程处理。
+** 链上所有的表都被监视起来，它们的任何结构变化都会让缓存失效。
+*/
+static const TValue *fillmethodcache (lua_State *L, MethodCache *mc,
+                                      Table *mt, TString *key) {
+  int loop;
+  Table *h = mt;
+  for (loop = 0; loop < MAXTAGLOOP; loop++) {
+    const TValue *tm = fasttm(L, h, TM_INDEX);
+    const TValue *slot;
+    Table *t;
+    int node;
+    if (tm == NULL || !ttistable(tm))
+      return NULL;  /* no '__index' table: not cacheable */
+    t = hvalue(tm);
+    luaH_watch(h);  /* its '__index' and metatable are part of the chain */
+    luaH_watch(t);  /* new keys in it may shadow the method */
+    slot = luaH_getshortstrhint(t, key, &node);
+    if (!ttisnil(slot)) {
+      int j;
+      for (j = 0; j < MCWAYS; j++) {  /* find old, free or stale entry */
+        if (mc[j].mt == mt || mc[j].mt == NULL ||
+            mc[j].epoch != G(L)->mcepoch)
+          break;
+      }
+      if (j == MCWAYS)  /* all in use? */
+        j = (point2uint(mt) >> 4) % MCWAYS;  /* replace one of them */
+      mc[j].mt = mt;
+      mc[j].holder = t;
+      mc[j].node = node;
+      mc[j].epoch = G(L)->mcepoch;
+      return slot;
+    }
+    if (t->metatable == NULL)
+      return NULL;  /* method is absent (nil); error will be raised later */
+    h = t->metatable;
+  }
+  return NULL;
+}
+
+
+/*
+** 通过OP_SELF的方法缓存'mc'为接收者'rb'查找方法'key'（接收者自身已经查找
+** 过并且没有这个key）。缓存项命中时只需比较元表、版本号并校验槽位上的key，
+** 不再调用luaV_finishget逐级查找'__index'链。返回NULL表示需要走常规流程。
+*/
+static const TValue *getmethod (lua_State *L, MethodCache *mc,
+                                const TValue *rb, TString *key) {
+  Table *mt;
+  int j;
+  switch (ttnov(rb)) {
+    case LUA_TTABLE: mt = hvalue(rb)->metatable; break;
+    case LUA_TUSERDATA: mt = uvalue(rb)->metatable; break;
+    default: mt = G(L)->mt[ttnov(rb)];
+  }
+  if (mt == NULL)
+    return NULL;
+  for (j = 0; j < MCWAYS; j++) {
+    if (mc[j].mt == mt && mc[j].epoch == G(L)->mcepoch) {
+      Table *holder = mc[j].holder;
+      if (luaH_hintmatch(holder, key, mc[j].node)) {
+        const TValue *slot = luaH_hintval(holder, mc[j].node);
+        return ttisnil(slot) ? NULL : slot;  /* method may have been removed */
+      }
+      break;  /* holder was rehashed; look it up again */
+    }
+  }
+  return fillmethodcache(L, mc, mt, key);
+}
+
+
 /*
 ** Compare two strings 'ls' x 'rs', returning an integer smaller-equal-
 ** -larger than zero if 'ls' is smaller-equal-larger than 'rs'.
@@ -382,8 +478,10 @@ int luaV_lessthan (lua_State *L, const TValue *l, const TValue *r) {
   int res;
   if (ttisnumber(l) && ttisnumber(r))  /* both operands are numbers? */
     return LTnum(l, r);
-  else if (ttisstring(l) && ttisstring(r))  /* both are strings? */
+  else if (ttisstring(l) && ttisstring(r)) {  /* both are strings? */
+    luaS_flat(L, tsvalue(l)); luaS_flat(L, tsvalue(r));
     return l_strcmp(tsvalue(l), tsvalue(r)) < 0;
+  }
   else if ((res = luaT_callorderTM(L, l, r, TM_LT)) < 0)  /* no metamethod? */
     luaG_ordererror(L, l, r);  /* error */
   return res;
@@ -402,8 +500,10 @@ int luaV_lessequal (lua_State *L, const TValue *l, const TValue *r) {
   int res;
   if (ttisnumber(l) && ttisnumber(r))  /* both operands are numbers? */
     return LEnum(l, r);
-  else if (ttisstring(l) && ttisstring(r))  /* both are strings? */
+  else if (ttisstring(l) && ttisstring(r)) {  /* both are strings? */
+    luaS_flat(L, tsvalue(l)); luaS_flat(L, tsvalue(r));
     return l_strcmp(tsvalue(l), tsvalue(r)) <= 0;
+  }
   else if ((res = luaT_callorderTM(L, l, r, TM_LE)) >= 0)  /* try 'le' */
     return res;
   else {  /* try 'lt': */
@@ -481,6 +581,18 @@ int luaV_equalobj (lua_State *L, const TValue *t1, const TValue *t2) {
 
 #define isemptystr(o)	(ttisshrstring(o) && tsvalue(o)->shrlen == 0)
 
+/*
+** give their contents to the lazy strings (ropes and substring views)
+** in stack from top - n up to top - 1, so that they can be copied.
+** Done before creating the result, as it allocates.
+*/
+static void flatbuff (lua_State *L, StkId top, int n) {
+  do {
+    luaS_flatvalue(L, top - n);
+  } while (--n > 0);
+}
+
+
 /* copy strings in stack from top - n up to top - 1 to buffer */
 static void copy2buff (StkId top, int n, char *buff) {
   size_t tl = 0;  /* size already copied */
@@ -522,12 +634,17 @@ void luaV_concat (lua_State *L, int total) {
           luaG_runerror(L, "string length overflow");
         tl += l;
       }
+      //结果需要复制时先展开惰性的操作数（子串视图可以比LUAI_MINROPE短）
+      if (tl < LUAI_MINROPE)  /* result will be a copy? */
+        flatbuff(L, top, n);
       if (tl <= LUAI_MAXSHORTLEN) {  /* is result a short string? */
         char buff[LUAI_MAXSHORTLEN];
         //copy top到top-n的字符串到buff
         copy2buff(top, n, buff);  /* copy strings to buffer */
         ts = luaS_newlstr(L, buff, tl);
       }
+      else if (tl >= LUAI_MINROPE)  /* long enough to be worth not copying? */
+        ts = luaS_newrope(L, top - n, n, tl);
       else {  /* long string; copy strings directly to final result */
         ts = luaS_createlngstrobj(L, tl);
         copy2buff(top, n, getstr(ts));
@@ -708,7 +825,8 @@ void luaV_finishOp (lua_State *L) {
   
   /* 获取函数被中断的指令 */
   Instruction inst = *(ci->u.l.savedpc - 1);  /* interrupted instruction */
-  OpCode op = GET_OPCODE(inst);
+  /* (another coroutine running the same code may have quickened it since) */
+  OpCode op = GET_BASEOP(inst);
   switch (op) {  /* finish its execution */
     case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_IDIV:
     case OP_BAND: case OP_BOR: case OP_BXOR: case OP_SHL: case OP_SHR:
@@ -802,6 +920,22 @@ void luaV_finishOp (lua_State *L) {
 
 #define Protect(x)	{ {x;}; base = ci->u.l.base; }
 
+
+/*
+** 把正在执行的指令原地改写为操作码'o'（快速化/反快速化）。
+** 指令的操作数不变，只改变随后执行时进入的分支。
+*/
+#define quicken(ci,o)  \
+	SET_OPCODE(*cast(Instruction *, (ci)->u.l.savedpc - 1), o)
+
+/*
+** 超级指令的结尾：下一条指令若是期待的操作码'o'，取出它（照常处理钩子）后
+** 直接跳到它的处理代码'lbl'，否则按正常方式分派
+*/
+#define vmfuse(o,lbl)  \
+	{ if (GET_OPCODE(*ci->u.l.savedpc) == (o)) { vmfetch(); goto lbl; } \
+	  vmbreak; }
+
 #define checkGC(L,c)  \
 	{ luaC_condGC(L, L->top = (c),  /* limit of live values */ \
                          Protect(L->top = ci->top));  /* restore top */ \
@@ -843,6 +977,32 @@ void luaV_finishOp (lua_State *L) {
     Protect(luaV_finishset(L,t,k,v,slot)); }
 
 
+/*
+** 以常量为key的RK操作数'x'在'slothint'中对应的槽位提示
+*/
+#define khint(x)	(cl->p->slothint + INDEXK(x))
+
+/* true when the RK operand 'x' is a constant short string */
+#define iskshrstr(x)	(ISK(x) && ttisshrstring(k + INDEXK(x)))
+
+/* raw access for a short-string key 'k' through the slot hint 'hint' */
+#define gethinted(h,k)	luaH_getshortstrh(h, tsvalue(k), hint)
+
+
+/*
+** versions of 'gettableProtected'/'settableProtected' for constant
+** short-string keys (global names, record fields, etc.): the lookup
+** first tries the node remembered for the key constant 'x'
+*/
+#define gettableHinted(L,t,k,v,x)  { const TValue *slot; int *hint = khint(x); \
+  if (luaV_fastget(L,t,k,slot,gethinted)) { setobj2s(L, v, slot); } \
+  else Protect(luaV_finishget(L,t,k,v,slot)); }
+
+#define settableHinted(L,t,k,v,x) { const TValue *slot; int *hint = khint(x); \
+  if (!luaV_fastset(L,t,k,slot,gethinted,v)) \
+    Protect(luaV_finishset(L,t,k,v,slot)); }
+
+
 // luaV_execute 是 Lua 虚拟机执行一段字节码的入口。如果把 Lua 虚拟机看成一个状态机
 // ，它就是从当前调用栈上次运行点开始解释字节码指令，直到下一个 C 边界跳出点。所谓 C 边界跳出点，可以是函数执
 // 行完毕，也可以是一次协程 yield 操作
@@ -865,6 +1025,9 @@ void luaV_execute (lua_State *L) {
 
   /* 当前执行函数的栈基址 */
   StkId base;
+#if LUA_USE_JUMPTABLE
+#include "ljumptab.h"
+#endif
   ci->callstatus |= CIST_FRESH;  /* fresh invocation of 'luaV_execute" */
 
   //定义了 newframe 这个跳转标签，函数调用 OP_CALL OP_TAILCALL 以及函数返回 OP_RETRUN 都会回
@@ -933,20 +1096,30 @@ void luaV_execute (lua_State *L) {
       vmcase(OP_GETTABUP) {
         TValue *upval = cl->upvals[GETARG_B(i)]->v;
         TValue *rc = RKC(i);
-        gettableProtected(L, upval, rc, ra);
+        //全局变量访问（_ENV.name）的key都是短字符串，走槽位提示
+        if (iskshrstr(GETARG_C(i))) {
+          gettableHinted(L, upval, rc, ra, GETARG_C(i));
+        }
+        else gettableProtected(L, upval, rc, ra);
         vmbreak;
       }
-      vmcase(OP_GETTABLE) {
+      vmcase(OP_GETTABLE) l_gettable: {
         StkId rb = RB(i);
         TValue *rc = RKC(i);
-        gettableProtected(L, rb, rc, ra);
+        if (iskshrstr(GETARG_C(i))) {
+          gettableHinted(L, rb, rc, ra, GETARG_C(i));
+        }
+        else gettableProtected(L, rb, rc, ra);
         vmbreak;
       }
       vmcase(OP_SETTABUP) {
         TValue *upval = cl->upvals[GETARG_A(i)]->v;
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
-        settableProtected(L, upval, rb, rc);
+        if (iskshrstr(GETARG_B(i))) {
+          settableHinted(L, upval, rb, rc, GETARG_B(i));
+        }
+        else settableProtected(L, upval, rb, rc);
         vmbreak;
       }
       vmcase(OP_SETUPVAL) {
@@ -958,7 +1131,10 @@ void luaV_execute (lua_State *L) {
       vmcase(OP_SETTABLE) {
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
-        settableProtected(L, ra, rb, rc);
+        if (iskshrstr(GETARG_B(i))) {
+          settableHinted(L, ra, rb, rc, GETARG_B(i));
+        }
+        else settableProtected(L, ra, rb, rc);
         vmbreak;
       }
       vmcase(OP_NEWTABLE) {
@@ -978,14 +1154,22 @@ void luaV_execute (lua_State *L) {
         StkId rb = RB(i);
         TValue *rc = RKC(i);
         TString *key = tsvalue(rc);  /* key must be a string */
+        const TValue *m;
         setobjs2s(L, ra + 1, rb);
         if (luaV_fastget(L, rb, key, aux, luaH_getstr)) {
           setobj2s(L, ra, aux);
         }
+        //接收者自身没有该方法时，先查这个方法名的方法缓存
+        else if (iskshrstr(GETARG_C(i)) &&
+                 (m = getmethod(L, cl->p->mcache +
+                       MCWAYS * cl->p->mcgroup[INDEXK(GETARG_C(i))], rb, key))) {
+          setobj2s(L, ra, m);
+        }
         else Protect(luaV_finishget(L, rb, rc, ra, aux));
         vmbreak;
       }
-      vmcase(OP_ADD) {
+      //通用的加减乘指令在结果类型确定时把自己快速化为特化版本，见OP_ADDII等
+      vmcase(OP_ADD) l_add: {
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
         lua_Number nb; lua_Number nc;
@@ -994,6 +1178,11 @@ void luaV_execute (lua_State *L) {
           lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
           //signed转unsigned做加法
           setivalue(ra, intop(+, ib, ic));
+          quicken(ci, ISK(GETARG_C(i)) ? OP_ADDIK : OP_ADDII);
+        }
+        else if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numadd(L, fltvalue(rb), fltvalue(rc)));
+          quicken(ci, OP_ADDFF);
         }
         //浮点型相加
         else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
@@ -1002,13 +1191,18 @@ void luaV_execute (lua_State *L) {
         else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_ADD)); }
         vmbreak;
       }
-      vmcase(OP_SUB) {
+      vmcase(OP_SUB) l_sub: {
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
         lua_Number nb; lua_Number nc;
         if (ttisinteger(rb) && ttisinteger(rc)) {
           lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
           setivalue(ra, intop(-, ib, ic));
+          quicken(ci, OP_SUBII);
+        }
+        else if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numsub(L, fltvalue(rb), fltvalue(rc)));
+          quicken(ci, OP_SUBFF);
         }
         else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
           setfltvalue(ra, luai_numsub(L, nb, nc));
@@ -1016,13 +1210,18 @@ void luaV_execute (lua_State *L) {
         else { Protect(luaT_trybinTM(L, rb, rc, ra, TM_SUB)); }
         vmbreak;
       }
-      vmcase(OP_MUL) {
+      vmcase(OP_MUL) l_mul: {
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
         lua_Number nb; lua_Number nc;
         if (ttisinteger(rb) && ttisinteger(rc)) {
           lua_Integer ib = ivalue(rb); lua_Integer ic = ivalue(rc);
           setivalue(ra, intop(*, ib, ic));
+          quicken(ci, OP_MULII);
+        }
+        else if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_nummul(L, fltvalue(rb), fltvalue(rc)));
+          quicken(ci, OP_MULFF);
         }
         else if (tonumber(rb, &nb) && tonumber(rc, &nc)) {
           setfltvalue(ra, luai_nummul(L, nb, nc));
@@ -1183,9 +1382,11 @@ void luaV_execute (lua_State *L) {
         dojump(ci, i, 0);
         vmbreak;
       }
-      vmcase(OP_EQ) {
+      vmcase(OP_EQ) l_eq: {
         TValue *rb = RKB(i);
         TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc))
+          quicken(ci, OP_EQII);
         Protect(
           if (luaV_equalobj(L, rb, rc) != GETARG_A(i))
             ci->u.l.savedpc++;
@@ -1194,18 +1395,30 @@ void luaV_execute (lua_State *L) {
         )
         vmbreak;
       }
-      vmcase(OP_LT) {
+      vmcase(OP_LT) l_lt: {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc))
+          quicken(ci, OP_LTII);
+        else if (ttisfloat(rb) && ttisfloat(rc))
+          quicken(ci, OP_LTFF);
         Protect(
-          if (luaV_lessthan(L, RKB(i), RKC(i)) != GETARG_A(i))
+          if (luaV_lessthan(L, rb, rc) != GETARG_A(i))
             ci->u.l.savedpc++;
           else
             donextjump(ci);
         )
         vmbreak;
       }
-      vmcase(OP_LE) {
+      vmcase(OP_LE) l_le: {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc))
+          quicken(ci, OP_LEII);
+        else if (ttisfloat(rb) && ttisfloat(rc))
+          quicken(ci, OP_LEFF);
         Protect(
-          if (luaV_lessequal(L, RKB(i), RKC(i)) != GETARG_A(i))
+          if (luaV_lessequal(L, rb, rc) != GETARG_A(i))
             ci->u.l.savedpc++;
           else
             donextjump(ci);
@@ -1229,7 +1442,7 @@ void luaV_execute (lua_State *L) {
         }
         vmbreak;
       }
-      vmcase(OP_CALL) {
+      vmcase(OP_CALL) l_call: {
         //B 为 0 时，表示传入参数是不定数量的，那么实际参数就由栈顶到函数对象的位置 A 的距离
         //决定。当 B 大于 0 时，参数个数为 B - 1 ，此时需要临时调整数据栈顶指针为 ra+b
         int b = GETARG_B(i);
@@ -1416,6 +1629,7 @@ void luaV_execute (lua_State *L) {
         TValue *pstep = ra + 2;
         lua_Integer ilimit;
         int stopnow;
+        luaS_flatvalue(L, plimit);  /* 'forlimit' cannot convert lazy ropes */
         if (ttisinteger(init) && ttisinteger(pstep) &&
             forlimit(plimit, &ilimit, ivalue(pstep), &stopnow)) {
           /* all values are integer */
@@ -1426,6 +1640,7 @@ void luaV_execute (lua_State *L) {
         }
         else {  /* try making all values floats */
           lua_Number ninit; lua_Number nlimit; lua_Number nstep;
+          luaS_flatvalue(L, pstep); luaS_flatvalue(L, init);
           if (!tonumber(plimit, &nlimit))
             luaG_runerror(L, "'for' limit must be a number");
           setfltvalue(plimit, nlimit);
@@ -1454,12 +1669,46 @@ void luaV_execute (lua_State *L) {
         //实际生成的字节码，迭代器调用在代码块的尾部。在循环体开头，用一条 UMP 指令，直接跳转到尾部
         // local var_1, ..., var_n = f(s, var) 这个过程对应于 OP_TFORCALL 这个操作
         StkId cb = ra + 3;  /* call base */
-        setobjs2s(L, cb+2, ra+2);
-        setobjs2s(L, cb+1, ra+1);
-        setobjs2s(L, cb, ra);
-        L->top = cb + 3;  /* func. + 2 args (state and index) */
-        Protect(luaD_call(L, cb, GETARG_C(i)));
-        L->top = ci->top;
+        /*
+        ** 'next'或者'ipairs'的迭代函数遍历一个表时直接在这里执行，省掉C函数
+        ** 调用；有call/return钩子时照常调用，钩子才能看到这次调用
+        */
+        if (ttislcf(ra) && ttistable(ra + 1) &&
+            !(L->hookmask & (LUA_MASKCALL | LUA_MASKRET)) &&
+            (fvalue(ra) == G(L)->nextf ||
+             (fvalue(ra) == G(L)->inextf && ttisinteger(ra + 2) &&
+              hvalue(ra + 1)->metatable == NULL))) {
+          Table *h = hvalue(ra + 1);
+          int c = GETARG_C(i);
+          int more;
+          if (fvalue(ra) == G(L)->nextf) {
+            setobjs2s(L, cb, ra + 2);
+            Protect(more = luaH_next(L, h, cb));  /* may raise an error */
+          }
+          else {  /* 'ipairs' over a table without metatable */
+            lua_Integer n = intop(+, ivalue(ra + 2), 1);
+            const TValue *v = luaH_getint(h, n);
+            more = !ttisnil(v);
+            if (more) {
+              setivalue(cb, n);
+              setobj2s(L, cb + 1, v);
+            }
+          }
+          if (!more) {
+            setnilvalue(cb);
+            setnilvalue(cb + 1);
+          }
+          for (; c > 2; c--)  /* extra variables get no values */
+            setnilvalue(cb + c - 1);
+        }
+        else {
+          setobjs2s(L, cb+2, ra+2);
+          setobjs2s(L, cb+1, ra+1);
+          setobjs2s(L, cb, ra);
+          L->top = cb + 3;  /* func. + 2 args (state and index) */
+          Protect(luaD_call(L, cb, GETARG_C(i)));
+          L->top = ci->top;
+        }
         i = *(ci->u.l.savedpc++);  /* go to next instruction */
         ra = RA(i);
         lua_assert(GET_OPCODE(i) == OP_TFORLOOP);
@@ -1497,9 +1746,12 @@ void luaV_execute (lua_State *L) {
         last = ((c-1)*LFIELDS_PER_FLUSH) + n;
         if (last > h->sizearray)  /* needs more space? */
           luaH_resizearray(L, h, last);  /* preallocate it at once */
-        for (; n > 0; n--) {
-          TValue *val = ra+n;
-          luaH_setint(L, h, last--, val);
+        if (last <= h->sizearray)  /* (not for a typed array part) */
+          h->lenhint = last;  /* usually the border after the constructor */
+        /* in order, so that filling the last slot can type the array */
+        for (c = 1; c <= n; c++) {
+          TValue *val = ra+c;
+          luaH_setint(L, h, last - n + c, val);
           luaC_barrierback(L, h, val);
         }
         L->top = ci->top;  /* correct top (in case of previous open call) */
@@ -1545,6 +1797,168 @@ void luaV_execute (lua_State *L) {
         lua_assert(0);
         vmbreak;
       }
+      /*
+      ** 快速化的指令：只检查特化时观察到的类型，检查失败就改写回通用指令，
+      ** 再跳到通用指令的处理代码（通用指令在类型合适时会再次特化）
+      */
+      vmcase(OP_ADDII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          setivalue(ra, intop(+, ivalue(rb), ivalue(rc)));
+        }
+        else { quicken(ci, OP_ADD); goto l_add; }
+        vmbreak;
+      }
+      vmcase(OP_ADDFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numadd(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else { quicken(ci, OP_ADD); goto l_add; }
+        vmbreak;
+      }
+      vmcase(OP_ADDIK) {
+        TValue *rb = RKB(i);
+        TValue *rc = k + INDEXK(GETARG_C(i));  /* always an integer */
+        lua_assert(ISK(GETARG_C(i)) && ttisinteger(rc));
+        if (ttisinteger(rb)) {
+          setivalue(ra, intop(+, ivalue(rb), ivalue(rc)));
+        }
+        else { quicken(ci, OP_ADD); goto l_add; }
+        vmbreak;
+      }
+      vmcase(OP_SUBII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          setivalue(ra, intop(-, ivalue(rb), ivalue(rc)));
+        }
+        else { quicken(ci, OP_SUB); goto l_sub; }
+        vmbreak;
+      }
+      vmcase(OP_SUBFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_numsub(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else { quicken(ci, OP_SUB); goto l_sub; }
+        vmbreak;
+      }
+      vmcase(OP_MULII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          setivalue(ra, intop(*, ivalue(rb), ivalue(rc)));
+        }
+        else { quicken(ci, OP_MUL); goto l_mul; }
+        vmbreak;
+      }
+      vmcase(OP_MULFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          setfltvalue(ra, luai_nummul(L, fltvalue(rb), fltvalue(rc)));
+        }
+        else { quicken(ci, OP_MUL); goto l_mul; }
+        vmbreak;
+      }
+      vmcase(OP_EQII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          if ((ivalue(rb) == ivalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else { quicken(ci, OP_EQ); goto l_eq; }
+        vmbreak;
+      }
+      vmcase(OP_LTII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          if ((ivalue(rb) < ivalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else { quicken(ci, OP_LT); goto l_lt; }
+        vmbreak;
+      }
+      vmcase(OP_LTFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          if (luai_numlt(fltvalue(rb), fltvalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else { quicken(ci, OP_LT); goto l_lt; }
+        vmbreak;
+      }
+      vmcase(OP_LEII) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisinteger(rb) && ttisinteger(rc)) {
+          if ((ivalue(rb) <= ivalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else { quicken(ci, OP_LE); goto l_le; }
+        vmbreak;
+      }
+      vmcase(OP_LEFF) {
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttisfloat(rb) && ttisfloat(rc)) {
+          if (luai_numle(fltvalue(rb), fltvalue(rc)) != GETARG_A(i))
+            ci->u.l.savedpc++;
+          else
+            donextjump(ci);
+        }
+        else { quicken(ci, OP_LE); goto l_le; }
+        vmbreak;
+      }
+      /*
+      ** 超级指令：先执行第一条指令，再直接进入第二条指令的处理代码
+      */
+      vmcase(OP_GETTABUP_GETTABLE) {
+        TValue *upval = cl->upvals[GETARG_B(i)]->v;
+        TValue *rc = RKC(i);
+        if (iskshrstr(GETARG_C(i))) {
+          gettableHinted(L, upval, rc, ra, GETARG_C(i));
+        }
+        else gettableProtected(L, upval, rc, ra);
+        vmfuse(OP_GETTABLE, l_gettable);
+      }
+      vmcase(OP_GETTABLE_GETTABLE) {
+        StkId rb = RB(i);
+        TValue *rc = RKC(i);
+        if (iskshrstr(GETARG_C(i))) {
+          gettableHinted(L, rb, rc, ra, GETARG_C(i));
+        }
+        else gettableProtected(L, rb, rc, ra);
+        vmfuse(OP_GETTABLE, l_gettable);
+      }
+      vmcase(OP_GETTABUP_CALL) {
+        TValue *upval = cl->upvals[GETARG_B(i)]->v;
+        TValue *rc = RKC(i);
+        if (iskshrstr(GETARG_C(i))) {
+          gettableHinted(L, upval, rc, ra, GETARG_C(i));
+        }
+        else gettableProtected(L, upval, rc, ra);
+        vmfuse(OP_CALL, l_call);
+      }
+      vmcase(OP_MOVE_CALL) {
+        setobjs2s(L, ra, RB(i));
+        vmfuse(OP_CALL, l_call);
+      }
     }
   }
 }
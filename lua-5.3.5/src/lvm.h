@@ -20,8 +20,12 @@
 #endif
 
 
+/*
+** (a rope not flattened yet is not converted here: the callers that
+** fail to convert it flatten it and retry; see 'luaT_trybinTM')
+*/
 #if !defined(LUA_NOCVTS2N)
-#define cvt2num(o)	ttisstring(o)
+#define cvt2num(o)	(ttisstring(o) && !islazy(tsvalue(o)))
 #else
 #define cvt2num(o)	0	/* no conversion from strings to numbers */
 #endif
@@ -78,7 +82,9 @@
 ** return false with 'slot' equal to NULL (if 't' is not a table) or
 ** 'nil'. (This is needed by 'luaV_finishget'.) Note that, if the macro
 ** returns true, there is no need to 'invalidateTMcache', because the
-** call is not creating a new entry.
+** call is not creating a new entry. (A watched table still invalidates
+** the method caches; see 'luaH_unwatch'. An element of a typed array
+** part is written to a copy and then stored back; see 'ltable.h'.)
 */
 #define luaV_fastset(L,t,k,slot,f,v) \
   (!ttistable(t) \
@@ -86,7 +92,9 @@
    : (slot = f(hvalue(t), k), \
      ttisnil(slot) ? 0 \
      : (luaC_barrierback(L, hvalue(t), v), \
+        luaH_checkwatch(L, hvalue(t)), \
         setobj2t(L, cast(TValue *,slot), v), \
+        luaH_checktyped(L, hvalue(t), slot), \
         1)))
 
 //在对表结构写操作的封装。在基础的表访问的基础上，增加了元方法的处理